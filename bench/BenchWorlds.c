@@ -0,0 +1,140 @@
+#include "BenchWorlds.h"
+
+static uint32_t bench_seed;
+
+static uint32_t Bench_Random(void);
+static Tile Bench_DefaultTile(void);
+static void Bench_GenerateFlat(World *world);
+static void Bench_GenerateRandomHeights(World *world);
+static void Bench_GenerateMaze(World *world);
+static void Bench_GenerateDiagonals(World *world);
+static void Bench_GenerateWorstCase(World *world);
+
+const BenchGenerator bench_generators[] = {
+	{ "flat", Bench_GenerateFlat },
+	{ "random-heights", Bench_GenerateRandomHeights },
+	{ "maze", Bench_GenerateMaze },
+	{ "diagonals", Bench_GenerateDiagonals },
+	{ "worst-case", Bench_GenerateWorstCase },
+};
+
+const int bench_num_generators = sizeof(bench_generators) / sizeof(bench_generators[0]);
+
+void BenchWorlds_Generate(World *world, int generator) {
+	bench_seed = 0x9e3779b9u;
+
+	World_Clear(world);
+	bench_generators[generator].generate(world);
+}
+
+static uint32_t Bench_Random(void) {
+	/* xorshift32, para os mundos serem iguais em qualquer plataforma */
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 17;
+	bench_seed ^= bench_seed << 5;
+
+	return bench_seed;
+}
+
+static Tile Bench_DefaultTile(void) {
+	Tile tile = {
+		.bot_height = 0.0f,
+		.top_height = 4.0f,
+		.bot_texture = 0,
+		.top_texture = 0,
+		.wall_texture = 1,
+		.bot_window_texture = 1,
+		.top_window_texture = 1,
+		.wall_type = WALLTYPE_NONE,
+	};
+
+	return tile;
+}
+
+static void Bench_GenerateFlat(World *world) {
+	Tile tile = Bench_DefaultTile();
+
+	for(int i = 0; i < world->width; i++) {
+		for(int j = 0; j < world->height; j++)
+			World_EditTile(world, i, j, &tile);
+	}
+}
+
+static void Bench_GenerateRandomHeights(World *world) {
+	Tile tile = Bench_DefaultTile();
+
+	for(int i = 0; i < world->width; i++) {
+		for(int j = 0; j < world->height; j++) {
+			tile.bot_height = (float) (Bench_Random() % 8) / 8.0f;
+			tile.top_height = 3.0f + (float) (Bench_Random() % 4) / 4.0f;
+			World_EditTile(world, i, j, &tile);
+		}
+	}
+}
+
+static void Bench_GenerateMaze(World *world) {
+	Tile tile;
+
+	/* Grade de células 2x2: os cantos são sempre parede e cada célula abre
+	 * uma passagem para a direita ou para cima */
+	for(int i = 0; i < world->width; i++) {
+		for(int j = 0; j < world->height; j++) {
+			tile = Bench_DefaultTile();
+
+			if(i % 2 == 0 || j % 2 == 0)
+				tile.wall_type = WALLTYPE_BLOCK;
+
+			World_EditTile(world, i, j, &tile);
+		}
+	}
+
+	for(int i = 1; i < world->width - 1; i += 2) {
+		for(int j = 1; j < world->height - 1; j += 2) {
+			tile = Bench_DefaultTile();
+
+			if(Bench_Random() & 1)
+				World_EditTile(world, i + 1, j, &tile);
+			else
+				World_EditTile(world, i, j + 1, &tile);
+		}
+	}
+}
+
+static void Bench_GenerateDiagonals(World *world) {
+	Tile tile = Bench_DefaultTile();
+
+	for(int i = 0; i < world->width; i++) {
+		for(int j = 0; j < world->height; j++) {
+			tile.wall_type = WALLTYPE_DIAGONAL_DOWNLEFT + Bench_Random() % 4;
+
+			if(Bench_Random() % 4 == 0)
+				tile.wall_type = WALLTYPE_NONE;
+
+			World_EditTile(world, i, j, &tile);
+		}
+	}
+}
+
+static void Bench_GenerateWorstCase(World *world) {
+	Tile tile;
+
+	/* Nada se junta e nada fica escondido: vizinhos sempre têm alturas,
+	 * texturas e formatos diferentes */
+	for(int i = 0; i < world->width; i++) {
+		for(int j = 0; j < world->height; j++) {
+			tile = Bench_DefaultTile();
+
+			tile.bot_height = (float) ((i + j) % 2) / 4.0f;
+			tile.top_height = 3.0f + (float) ((i + 2 * j) % 3) / 4.0f;
+			tile.bot_texture = i % 2;
+			tile.top_texture = j % 2;
+
+			if((i + j) % 2 == 0)
+				tile.wall_type = WALLTYPE_HALFBLOCK_MIDDLE;
+			else if(i % 3 == 0)
+				tile.wall_type = WALLTYPE_DIAGONAL_DOWNLEFT + (j % 4);
+
+			World_EditTile(world, i, j, &tile);
+		}
+	}
+}
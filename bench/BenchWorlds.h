@@ -0,0 +1,25 @@
+#ifndef BENCHWORLDS_H
+#define BENCHWORLDS_H
+
+#include "engine/World.h"
+
+/* Mundos sintéticos usados pelos benchmarks. São determinísticos, então
+ * os números de execuções diferentes podem ser comparados. */
+
+/* Todos os mundos têm esse tamanho, em tiles */
+#define BENCH_WORLD_SIZE 256
+#define BENCH_MAX_CHUNKS ( (BENCH_WORLD_SIZE / CHUNK_SIZE) * (BENCH_WORLD_SIZE / CHUNK_SIZE) )
+
+typedef struct {
+	const char *name;
+	void (*generate)(World *world);
+} BenchGenerator;
+
+extern const BenchGenerator bench_generators[];
+extern const int bench_num_generators;
+
+/* Esvazia o mundo, criado com BENCH_WORLD_SIZE e BENCH_MAX_CHUNKS, e
+ * preenche com o gerador escolhido */
+void BenchWorlds_Generate(World *world, int generator);
+
+#endif
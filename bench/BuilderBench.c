@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "base/Memory.h"
+#include "engine/Builder.h"
+#include "engine/World.h"
+
+#include "BenchWorlds.h"
+
+/* Mede o builder sem janela nem contexto GL: gera mundos sintéticos,
+ * constrói a geometria de todos os chunks e mostra os números. */
+
+#define BENCH_MEMORY ( (size_t) 256 * 1024 * 1024 )
+#define BENCH_SCRATCH_MEMORY ( 16 * 1024 * 1024 )
+#define BENCH_DEFAULT_ITERATIONS 5
+
+typedef struct {
+	double ns_per_tile;
+	double quads_per_chunk;
+	double lod_quads_per_chunk[CHUNK_NUM_LODS];
+	size_t max_quads;
+	size_t bytes;
+	size_t scratch_high_water;
+	int failed_chunks;
+} BenchResult;
+
+static void Bench_Run(BenchResult *result, const World *world, Memory *scratch, int iterations);
+
+int main(int argc, char **argv) {
+	Memory memory, scratch;
+	BenchResult result;
+	World *world;
+	void *block;
+	int iterations = BENCH_DEFAULT_ITERATIONS;
+
+	if(argc > 1)
+		iterations = atoi(argv[1]);
+
+	if(iterations < 1)
+		iterations = 1;
+
+	if(!Memory_Reserve(&memory, BENCH_MEMORY, MEMORY_HUGE_PAGES_TRANSPARENT))
+		return 1;
+
+	world = Memory_AllocTagged(&memory, sizeof(World), MEMORY_CACHE_LINE, MEMTAG_WORLD);
+	block = Memory_AllocTagged(&memory, BENCH_SCRATCH_MEMORY, MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+	if(world == NULL || block == NULL || !World_Create(world, &memory, BENCH_WORLD_SIZE, BENCH_WORLD_SIZE, BENCH_MAX_CHUNKS)) {
+		fprintf(stderr, "Not enough memory for the benchmark.\n");
+		Memory_Release(&memory);
+		return 1;
+	}
+
+	scratch = Memory_Create(block, BENCH_SCRATCH_MEMORY);
+
+	printf("%d chunks of %dx%d tiles, %d iterations\n", BENCH_MAX_CHUNKS, CHUNK_SIZE, CHUNK_SIZE, iterations);
+	printf("%-16s %12s %12s %10s %12s %12s %7s  %s\n", "generator", "ns/tile", "quads/chunk", "max quads", "bytes", "scratch", "failed", "quads/chunk per LOD");
+
+	for(int i = 0; i < bench_num_generators; i++) {
+		BenchWorlds_Generate(world, i);
+
+		Bench_Run(&result, world, &scratch, iterations);
+
+		printf(
+				"%-16s %12.2f %12.1f %10zu %12zu %12zu %7d ",
+				bench_generators[i].name,
+				result.ns_per_tile,
+				result.quads_per_chunk,
+				result.max_quads,
+				result.bytes,
+				result.scratch_high_water,
+				result.failed_chunks
+			  );
+
+		for(int lod = 0; lod < CHUNK_NUM_LODS; lod++)
+			printf(" %10.1f", result.lod_quads_per_chunk[lod]);
+
+		printf("\n");
+	}
+
+	Memory_Release(&memory);
+
+	return 0;
+}
+
+static void Bench_Run(BenchResult *result, const World *world, Memory *scratch, int iterations) {
+	ChunkGeometry geometry[CHUNK_NUM_LODS];
+	Uint64 start, elapsed = 0;
+	size_t lod_quads[CHUNK_NUM_LODS] = {0};
+	size_t total_quads = 0;
+	size_t num_chunks = 0;
+	double num_tiles;
+
+	result->max_quads = 0;
+	result->bytes = 0;
+	result->scratch_high_water = 0;
+	result->failed_chunks = 0;
+
+	for(int k = 0; k < iterations; k++) {
+		for(int i = 0; i < world->num_chunks; i++) {
+			Memory_Free(scratch);
+
+			start = SDL_GetPerformanceCounter();
+
+			if(!Builder_BuildChunkGeometry(geometry, scratch, world, world->chunks[i]->index)) {
+				result->failed_chunks++;
+				continue;
+			}
+
+			elapsed += SDL_GetPerformanceCounter() - start;
+
+			if(scratch->top > result->scratch_high_water)
+				result->scratch_high_water = scratch->top;
+
+			/* Os números de geometria são iguais em toda iteração. As
+			 * colunas principais são do LOD 0 e bytes soma todos os LODs. */
+			if(k == 0) {
+				total_quads += geometry[0].num_vertices / 4;
+
+				if(geometry[0].num_vertices / 4 > result->max_quads)
+					result->max_quads = geometry[0].num_vertices / 4;
+
+				for(int lod = 0; lod < CHUNK_NUM_LODS; lod++) {
+					lod_quads[lod] += geometry[lod].num_vertices / 4;
+					result->bytes += geometry[lod].num_vertices * sizeof(PackedVertex);
+				}
+			}
+
+			num_chunks++;
+		}
+	}
+
+	result->failed_chunks /= iterations;
+	result->quads_per_chunk = world->num_chunks == 0 ? 0.0 : (double) total_quads / world->num_chunks;
+
+	for(int lod = 0; lod < CHUNK_NUM_LODS; lod++)
+		result->lod_quads_per_chunk[lod] = world->num_chunks == 0 ? 0.0 : (double) lod_quads[lod] / world->num_chunks;
+
+	num_tiles = (double) num_chunks * CHUNK_SIZE * CHUNK_SIZE;
+	result->ns_per_tile = num_tiles == 0.0 ? 0.0 : 1e9 * (double) elapsed / (double) SDL_GetPerformanceFrequency() / num_tiles;
+}
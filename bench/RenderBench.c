@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "base/Context.h"
+#include "base/Memory.h"
+#include "engine/Builder.h"
+#include "engine/TileRenderer.h"
+#include "engine/World.h"
+
+#include "BenchWorlds.h"
+
+/* Compara os dois caminhos de desenho do mundo: meshes do Builder e o
+ * TileRenderer, que gera a geometria no vertex shader. Precisa de uma
+ * janela com contexto GL 3.3. Para cada mundo sintético mede o tempo
+ * para deixar o mundo pronto, o tempo de GPU por quadro e o custo de
+ * editar um tile até ele estar na GPU. */
+
+#define BENCH_MEMORY ( (size_t) 256 * 1024 * 1024 )
+#define BENCH_STACK_MEMORY ( (size_t) 256 * 1024 * 1024 )
+#define BENCH_SCRATCH_MEMORY ( 16 * 1024 * 1024 )
+#define BENCH_DEFAULT_FRAMES 100
+#define BENCH_EDITS 64
+
+typedef struct {
+	double setup_ms;
+	double frame_ms;
+	double edit_us;
+} BenchResult;
+
+static double Bench_GetMs(Uint64 ticks);
+static void Bench_EditTile(World *world, int i, int j);
+static void Bench_RunBuilder(BenchResult *result, World *world, Memory *stack, Memory *scratch, const Mat4 *view, const Mat4 *projection, int frames);
+static void Bench_RunTileRenderer(BenchResult *result, World *world, Memory *stack, const Mat4 *view, const Mat4 *projection, int frames);
+static void Bench_PrintResult(const char *generator, const char *path, const BenchResult *result);
+
+int main(int argc, char **argv) {
+	Memory memory, stack, scratch;
+	Context *context;
+	BenchResult result;
+	World *world;
+	Mat4 view, projection;
+	void *block;
+	int frames = BENCH_DEFAULT_FRAMES;
+
+	if(argc > 1)
+		frames = atoi(argv[1]);
+
+	if(frames < 1)
+		frames = 1;
+
+	if(!Memory_Reserve(&memory, BENCH_MEMORY, MEMORY_HUGE_PAGES_TRANSPARENT))
+		return 1;
+
+	if(!Memory_Reserve(&stack, BENCH_STACK_MEMORY, MEMORY_HUGE_PAGES_TRANSPARENT))
+		return 1;
+
+	context = Context_Create("render bench", 1280, 720, &memory, &stack);
+
+	if(context == NULL) {
+		fprintf(stderr, "Failed to create the GL context.\n");
+		return 1;
+	}
+
+	world = Memory_AllocTagged(&memory, sizeof(World), MEMORY_CACHE_LINE, MEMTAG_WORLD);
+	block = Memory_AllocTagged(&memory, BENCH_SCRATCH_MEMORY, MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+	if(world == NULL || block == NULL || !World_Create(world, &memory, BENCH_WORLD_SIZE, BENCH_WORLD_SIZE, BENCH_MAX_CHUNKS)) {
+		fprintf(stderr, "Not enough memory for the benchmark.\n");
+		return 1;
+	}
+
+	scratch = Memory_Create(block, BENCH_SCRATCH_MEMORY);
+
+	if(!Shader_LoadFiles(&world->shader, &stack, "res/shaders/chunk.vs", "res/shaders/chunk.fs"))
+		return 1;
+
+	Memory_Free(&stack);
+
+	TextureArray_Create(&world->tile_textures, 64, 64);
+	TextureArray_Load(&world->tile_textures, "floor.png");
+	TextureArray_Load(&world->tile_textures, "wall.png");
+
+	/* Câmera no meio do mundo, como a do jogo */
+	Mat4_Transform(&view, -BENCH_WORLD_SIZE / 2.0f, -0.5f, -BENCH_WORLD_SIZE / 2.0f);
+	Mat4_PerspectiveProjection(&projection, 16.0f / 9.0f, 3.14 / 4, 100.0f, 0.2f);
+
+	printf("%d frames, %d edits\n", frames, BENCH_EDITS);
+	printf("%-16s %-8s %12s %12s %12s\n", "generator", "path", "setup ms", "frame ms", "edit us");
+
+	for(int i = 0; i < bench_num_generators; i++) {
+		BenchWorlds_Generate(world, i);
+		Bench_RunBuilder(&result, world, &stack, &scratch, &view, &projection, frames);
+		Bench_PrintResult(bench_generators[i].name, "builder", &result);
+
+		BenchWorlds_Generate(world, i);
+		Bench_RunTileRenderer(&result, world, &stack, &view, &projection, frames);
+		Bench_PrintResult(bench_generators[i].name, "gpu", &result);
+	}
+
+	Shader_Destroy(&world->shader);
+	Context_Destroy(context);
+	Memory_Release(&memory);
+	Memory_Release(&stack);
+
+	return 0;
+}
+
+static double Bench_GetMs(Uint64 ticks) {
+	return 1e3 * (double) ticks / (double) SDL_GetPerformanceFrequency();
+}
+
+static void Bench_EditTile(World *world, int i, int j) {
+	Tile tile;
+
+	World_GetTile(world, i, j, &tile);
+
+	tile.bot_height = tile.bot_height == 0.0f ? 0.5f : 0.0f;
+	World_EditTile(world, i, j, &tile);
+}
+
+static void Bench_RunBuilder(BenchResult *result, World *world, Memory *stack, Memory *scratch, const Mat4 *view, const Mat4 *projection, int frames) {
+	ChunkGeometry geometry[CHUNK_NUM_LODS];
+	Chunk *chunk;
+	Uint64 start;
+	int chunk_index, i, j;
+
+	start = SDL_GetPerformanceCounter();
+	Builder_BuildMesh(stack, world, NULL);
+	glFinish();
+	result->setup_ms = Bench_GetMs(SDL_GetPerformanceCounter() - start);
+
+	start = SDL_GetPerformanceCounter();
+
+	for(int f = 0; f < frames; f++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		World_Render(world, view, projection);
+		glFinish();
+	}
+
+	result->frame_ms = Bench_GetMs(SDL_GetPerformanceCounter() - start) / frames;
+
+	/* Uma edição só termina quando o chunk foi refeito e enviado */
+	start = SDL_GetPerformanceCounter();
+
+	for(int k = 0; k < BENCH_EDITS; k++) {
+		/* As edições andam num bloco de 8x8 tiles no meio do mundo */
+		i = BENCH_WORLD_SIZE / 2 + k % 8;
+		j = BENCH_WORLD_SIZE / 2 + k / 8;
+
+		Bench_EditTile(world, i, j);
+
+		chunk_index = World_GetChunkIndex(world, i, j);
+		chunk = World_GetChunk(world, chunk_index);
+
+		Memory_Free(scratch);
+
+		if(!Builder_BuildChunkGeometry(geometry, scratch, world, chunk_index))
+			continue;
+
+		for(int lod = 0; lod < CHUNK_NUM_LODS; lod++)
+			Mesh_UpdatePacked(&chunk->lods[lod], geometry[lod].vertices, geometry[lod].num_vertices);
+
+		glFinish();
+	}
+
+	result->edit_us = 1e3 * Bench_GetMs(SDL_GetPerformanceCounter() - start) / BENCH_EDITS;
+
+	/* Libera as meshes antes do próximo mundo */
+	World_Clear(world);
+}
+
+static void Bench_RunTileRenderer(BenchResult *result, World *world, Memory *stack, const Mat4 *view, const Mat4 *projection, int frames) {
+	TileRenderer renderer;
+	Uint64 start;
+	int i, j;
+
+	start = SDL_GetPerformanceCounter();
+
+	if(!TileRenderer_Create(&renderer, stack, world)) {
+		*result = (BenchResult) {0.0, 0.0, 0.0};
+		return;
+	}
+
+	glFinish();
+	result->setup_ms = Bench_GetMs(SDL_GetPerformanceCounter() - start);
+
+	start = SDL_GetPerformanceCounter();
+
+	for(int f = 0; f < frames; f++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		TileRenderer_Render(&renderer, world, view, projection);
+		glFinish();
+	}
+
+	result->frame_ms = Bench_GetMs(SDL_GetPerformanceCounter() - start) / frames;
+
+	start = SDL_GetPerformanceCounter();
+
+	for(int k = 0; k < BENCH_EDITS; k++) {
+		i = BENCH_WORLD_SIZE / 2 + k % 8;
+		j = BENCH_WORLD_SIZE / 2 + k / 8;
+
+		Bench_EditTile(world, i, j);
+		TileRenderer_UpdateTile(&renderer, world, i, j);
+		glFinish();
+	}
+
+	result->edit_us = 1e3 * Bench_GetMs(SDL_GetPerformanceCounter() - start) / BENCH_EDITS;
+
+	TileRenderer_Destroy(&renderer);
+}
+
+static void Bench_PrintResult(const char *generator, const char *path, const BenchResult *result) {
+	printf("%-16s %-8s %12.2f %12.3f %12.1f\n", generator, path, result->setup_ms, result->frame_ms, result->edit_us);
+}
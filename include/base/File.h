@@ -0,0 +1,34 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "base/Memory.h"
+
+/* Visão somente leitura do conteúdo de um arquivo.
+ * Quando possível o arquivo é mapeado com mmap, sem cópia. */
+
+typedef enum {
+	FILE_ACCESS_NORMAL = 0,
+	FILE_ACCESS_SEQUENTIAL,
+	FILE_ACCESS_RANDOM
+} FileAccess;
+
+typedef struct {
+	const char *data;
+	size_t size;
+	bool mapped;
+} FileView;
+
+bool File_Map(FileView *view, const char *filename, FileAccess access);
+
+/* Lê o arquivo inteiro para dentro de mems, terminado em '\0'. */
+bool File_Read(FileView *view, Memory *mems, const char *filename);
+
+/* Tenta mapear o arquivo e, se não conseguir, lê para dentro de mems. */
+bool File_Open(FileView *view, Memory *mems, const char *filename, FileAccess access);
+
+void File_Release(FileView *view);
+
+#endif
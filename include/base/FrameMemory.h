@@ -0,0 +1,32 @@
+#ifndef FRAME_MEMORY_H
+#define FRAME_MEMORY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "base/Memory.h"
+
+/* Memória temporária por frame com dois buffers.
+ * O que for alocado no frame N continua válido durante o frame N + 1,
+ * e é descartado no início do frame N + 2. */
+
+#define FRAME_MEMORY_WARNING_RATIO 0.875f
+
+typedef struct {
+	Memory buffers[2];
+	int current;
+
+	size_t frame;
+	size_t high_water;
+} FrameMemory;
+
+bool FrameMemory_Create(FrameMemory *frame, Memory *mems, size_t size);
+
+/* Deve ser chamada uma vez no início de cada frame. */
+void FrameMemory_Swap(FrameMemory *frame);
+
+void * FrameMemory_Alloc(FrameMemory *frame, size_t size);
+
+void * FrameMemory_AllocAligned(FrameMemory *frame, size_t size, size_t alignment);
+
+#endif
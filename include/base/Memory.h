@@ -2,28 +2,113 @@
 #define MEMS_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
 /* Stack de alocação de memória.
  * Evitar usar malloc e fragmentar a memória. */
 
+#define MEMORY_DEFAULT_ALIGNMENT 16
+#define MEMORY_CACHE_LINE 64
+
+#define MEMORY_COMMIT_GRANULARITY ( 64 * 1024 )
+#define MEMORY_HUGE_PAGE_SIZE ( 2 * 1024 * 1024 )
+
+/* Com MEMORY_DEBUG, cada alocação é seguida por bytes de guarda que são
+ * verificados quando um escopo é fechado ou a stack é liberada. */
+#define MEMORY_GUARD_SIZE 24
+#define MEMORY_GUARD_BYTE 0xfd
+
+/* Flags para Memory_Reserve */
+enum {
+	MEMORY_HUGE_PAGES_TRANSPARENT = 1 << 0,
+	MEMORY_HUGE_PAGES_EXPLICIT = 1 << 1
+};
+
+typedef enum {
+	MEMTAG_GENERAL = 0,
+	MEMTAG_CONTEXT,
+	MEMTAG_GAME,
+	MEMTAG_WORLD,
+	MEMTAG_BUILDER,
+	MEMTAG_RENDERER,
+	MEMTAG_ENTITIES,
+	MEMTAG_ASSETS,
+	MEMTAG_FRAME,
+	MEMTAG_NUMTAGS
+} MemoryTag;
+
+typedef struct {
+	size_t live;
+	size_t peak;
+	size_t count;
+} MemoryTagStats;
+
 typedef struct {
 	char *block;
 	size_t size;
 	size_t top;
+
+	/* Arenas reservadas só têm [0, committed) acessível */
+	size_t committed;
+	size_t granularity;
+	bool reserved;
+
+	int depth;
+
+	MemoryTag tag;
+	MemoryTagStats tags[MEMTAG_NUMTAGS];
+
+	/* Posição + 1 da última guarda, 0 se não houver */
+	size_t last_guard;
 } Memory;
 
+/* Marca o topo da stack para ser restaurado depois.
+ * Escopos podem ser aninhados, mas devem ser fechados na ordem inversa. */
+typedef struct {
+	Memory *mems;
+	size_t top;
+	int depth;
+
+	size_t live[MEMTAG_NUMTAGS];
+	size_t last_guard;
+} MemoryScope;
+
 Memory Memory_Create(void *block, size_t size);
 
+/* Reserva size bytes de endereço virtual sem ocupar memória física.
+ * As páginas são liberadas para uso conforme a stack cresce, e os
+ * ponteiros já entregues nunca mudam. */
+bool Memory_Reserve(Memory *mems, size_t size, int flags);
+
+/* Devolve uma reserva feita com Memory_Reserve. */
+void Memory_Release(Memory *mems);
+
 void * Memory_Alloc(Memory *mems, size_t size);
 
+/* alignment deve ser uma potência de 2. Retorna NULL se não houver espaço. */
+void * Memory_AllocAligned(Memory *mems, size_t size, size_t alignment);
+
+void * Memory_AllocTagged(Memory *mems, size_t size, size_t alignment, MemoryTag tag);
+
+/* Define a tag usada por Memory_Alloc e retorna a anterior. */
+MemoryTag Memory_SetTag(Memory *mems, MemoryTag tag);
+
 void Memory_Free(Memory *mems);
 
 void * Memory_GetTop(Memory *mems);
 
-size_t Memory_SaveState(Memory *mems);
+MemoryScope Memory_BeginScope(Memory *mems);
+
+bool Memory_EndScope(MemoryScope *scope);
+
+/* Verifica as guardas colocadas acima de from. Sem MEMORY_DEBUG sempre
+ * retorna true. */
+bool Memory_CheckGuards(const Memory *mems, size_t from);
+
+const MemoryTagStats * Memory_GetTagStats(const Memory *mems, MemoryTag tag);
 
-void Memory_RestoreState(Memory *mems, size_t old_state);
+const char * Memory_GetTagName(MemoryTag tag);
 
-const char * Memory_ReadFileAsString(Memory *mems, const char *filename);
+void Memory_PrintReport(const Memory *mems, const char *name);
 
 #endif
@@ -0,0 +1,46 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "base/Memory.h"
+
+/* Pool de objetos de tamanho fixo, alocado a partir de uma Memory.
+ * Alocar e liberar custam O(1): os slots livres formam uma lista
+ * encadeada guardada dentro dos próprios slots. Um bit por slot diz se
+ * ele está livre, para que liberar duas vezes seja recusado. */
+
+typedef struct PoolSlot {
+	struct PoolSlot *next;
+} PoolSlot;
+
+typedef struct {
+	char *block;
+	PoolSlot *free_list;
+	uint32_t *free_bits;
+
+	size_t slot_size;
+	size_t num_slots;
+
+	size_t used;
+	size_t peak;
+	size_t num_allocs;
+	size_t num_frees;
+} Pool;
+
+bool Pool_Create(Pool *pool, Memory *mems, size_t object_size, size_t num_slots);
+
+void * Pool_Alloc(Pool *pool);
+
+/* Falha se o objeto não é do pool ou já está livre */
+bool Pool_Free(Pool *pool, void *object);
+
+void Pool_Reset(Pool *pool);
+
+bool Pool_Contains(const Pool *pool, const void *object);
+
+void Pool_PrintStats(const Pool *pool, const char *name);
+
+#endif
@@ -7,6 +7,37 @@
 
 #include <stdbool.h>
 
-void Builder_BuildMesh(Memory *stack, World *world);
+/* Vértices de um LOD de um chunk, em grupos de 4 por quad */
+typedef struct {
+	const PackedVertex *vertices;
+	size_t num_vertices;
+} ChunkGeometry;
+
+/* Aumentar sempre que a geometria gerada mudar, para invalidar o cache */
+#define BUILDER_VERSION 6
+
+/* Constrói todos os chunks. Se cache_filename não for NULL, os chunks que
+ * não mudaram são lidos do cache e os demais são gravados nele. */
+void Builder_BuildMesh(Memory *stack, World *world, const char *cache_filename);
+
+/* Gera a geometria de todos os LODs de um chunk sem tocar na GPU, em
+ * geometry[0] até geometry[CHUNK_NUM_LODS - 1]. Os vértices ficam em
+ * scratch e valem até ele ser liberado. chunk é o índice na grade, como
+ * em World_GetChunkIndex; retorna false se o chunk não existe. */
+bool Builder_BuildChunkGeometry(ChunkGeometry *geometry, Memory *scratch, const World *world, int chunk);
+
+/* Inicia as threads que refazem chunks em segundo plano. A memória dos
+ * workers sai de memory e dura enquanto o Builder existir. */
+Builder * Builder_Create(Memory *memory, World *world);
+
+void Builder_Destroy(Builder *builder);
+
+/* Manda os chunks marcados como sujos para os workers. Retorna quantos
+ * foram enviados. */
+int Builder_QueueDirtyChunks(Builder *builder);
+
+/* Sobe para a GPU os chunks prontos até gastar budget_ms. Até lá cada
+ * chunk continua desenhando a mesh antiga. Retorna quantos subiram. */
+int Builder_UploadReady(Builder *builder, float budget_ms);
 
 #endif
@@ -0,0 +1,68 @@
+#ifndef CHUNKCACHE_H
+#define CHUNKCACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "engine/Types.h"
+#include "base/File.h"
+#include "base/Memory.h"
+
+/* Cache em disco das meshes dos chunks. O arquivo tem um cabeçalho, um
+ * diretório com uma entrada por LOD de cada chunk e depois os vértices,
+ * prontos para irem direto para o Mesh_CreatePacked a partir do mmap.
+ *
+ * Cada entrada guarda o hash dos tiles do chunk, da borda ao redor dele,
+ * das luzes que o alcançam e da versão do builder. Um chunk só é refeito quando o hash muda. */
+
+#define CHUNK_CACHE_MAGIC "CMSH"
+#define CHUNK_CACHE_ALIGNMENT 16
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t num_chunks;
+	uint32_t num_lods;
+	uint32_t vertex_size;
+	uint32_t chunks_x;
+} ChunkCacheHeader;
+
+typedef struct {
+	uint64_t hash;
+	uint64_t offset;
+	uint64_t num_vertices;
+} ChunkCacheEntry;
+
+typedef struct {
+	FileView view;
+	const ChunkCacheEntry *old_entries;
+
+	/* Um por chunk da grade do mundo, existindo ou não */
+	int num_chunks, chunks_x;
+	uint64_t *hashes;
+	ChunkCacheEntry *entries;
+
+	const char *filename;
+	char temp_filename[256];
+	FILE *out;
+	uint64_t out_size;
+	bool failed;
+} ChunkCache;
+
+/* Mapeia o cache antigo, se existir, e calcula o hash de cada chunk. O
+ * diretório sai de stack e vale até o ChunkCache_Close. */
+bool ChunkCache_Open(ChunkCache *cache, Memory *stack, const World *world, const char *filename);
+
+uint64_t ChunkCache_HashChunk(const World *world, int chunk);
+
+/* Retorna os vértices guardados se o hash do chunk não mudou */
+bool ChunkCache_Find(const ChunkCache *cache, int chunk, int lod, const PackedVertex **vertices, size_t *num_vertices);
+
+/* Guarda os vértices de um chunk recém construído no novo arquivo */
+bool ChunkCache_Store(ChunkCache *cache, int chunk, int lod, const PackedVertex *vertices, size_t num_vertices);
+
+/* Copia os chunks que não mudaram e troca o arquivo antigo pelo novo */
+bool ChunkCache_Close(ChunkCache *cache);
+
+#endif
@@ -7,6 +7,8 @@ Game * Game_Create(Context *context);
 
 void Game_Run(Game *game);
 
+void Game_Destroy(Game *game);
+
 Entity * Game_AddEntity(Game *game);
 
 #endif
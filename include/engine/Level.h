@@ -0,0 +1,103 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "engine/Types.h"
+#include "base/File.h"
+#include "base/Memory.h"
+
+/* Nível em disco, lido do mmap sem parse. O arquivo tem:
+ *
+ *   LevelHeader
+ *   LevelChunkEntry[chunks_x * chunks_y], um por chunk da grade
+ *   LevelSpawn[num_spawns]
+ *   WorldLight[num_lights]
+ *   blocos de tiles, alinhados em LEVEL_ALIGNMENT
+ *
+ * Cada bloco tem CHUNK_SIZE * CHUNK_SIZE PackedTile na mesma ordem Z de
+ * Chunk.tiles e é copiado com um memcpy para um chunk do pool. A cópia
+ * é de propósito: o chunk precisa de memória gravável para as edições e
+ * para o apron, que não existe no arquivo, e o mmap fica só de leitura.
+ * Sem streaming o jogo fecha o nível logo depois de carregar; com ele, só
+ * os chunks residentes são copiados. Tudo fica na ordem de bytes da
+ * máquina, como no cache dos chunks.
+ *
+ * O checksum do cabeçalho cobre o cabeçalho, o diretório, os spawns e as
+ * luzes e é conferido no Level_Open. O de cada bloco só é conferido na
+ * primeira vez que o chunk é pedido, para que abrir um mapa grande não
+ * leia o arquivo inteiro.
+ *
+ * Os níveis são gerados a partir de texto pelo tools/LevelConvert.c. */
+
+#define LEVEL_MAGIC "SLVL"
+#define LEVEL_VERSION 2
+#define LEVEL_ALIGNMENT 16
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t chunk_size;
+	uint32_t tile_size;
+	uint32_t chunks_x, chunks_y;
+	uint32_t num_spawns;
+	uint32_t num_lights;
+
+	/* Calculado com este campo em 0 */
+	uint64_t checksum;
+} LevelHeader;
+
+/* offset == 0 para chunks vazios, que ficam sólidos */
+typedef struct {
+	uint64_t offset;
+	uint64_t checksum;
+} LevelChunkEntry;
+
+typedef enum {
+	LEVEL_CHUNK_UNCHECKED = 0,
+	LEVEL_CHUNK_VALID,
+	LEVEL_CHUNK_CORRUPT
+} LevelChunkState;
+
+struct Level {
+	FileView view;
+	const LevelHeader *header;
+	const LevelChunkEntry *entries;
+	const LevelSpawn *spawns;
+	const WorldLight *lights;
+
+	int chunks_x, chunks_y;
+
+	/* Chunks com tiles no arquivo */
+	int num_chunks;
+
+	/* Um LevelChunkState por chunk da grade */
+	uint8_t *states;
+};
+
+/* Mapeia o nível; se não der, lê para dentro de mems. O estado dos
+ * chunks também sai de mems. */
+bool Level_Open(Level *level, Memory *mems, const char *filename);
+
+/* Se o chunk tem tiles no arquivo, sem ler os tiles */
+bool Level_HasChunk(const Level *level, int index);
+
+/* Tiles de um chunk, índice como em World_GetChunkIndex. NULL se o chunk
+ * está vazio ou o bloco não bate com o checksum. */
+const PackedTile * Level_GetChunkTiles(Level *level, int index);
+
+/* Cria o mundo com o tamanho do nível e as luzes dele, cabendo
+ * max_chunks chunks. Os chunks ficam para Level_LoadChunks ou para o
+ * Streamer. */
+bool Level_CreateWorld(const Level *level, World *world, Memory *memory, int max_chunks);
+
+/* Carrega todos os chunks do nível no mundo */
+bool Level_LoadChunks(Level *level, World *world);
+
+/* Grava os chunks que existem no mundo, as luzes dele e os spawns */
+bool Level_Save(const World *world, const LevelSpawn *spawns, int num_spawns, const char *filename);
+
+void Level_Close(Level *level);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef STREAMER_H
+#define STREAMER_H
+
+#include "engine/Types.h"
+#include "engine/Level.h"
+#include "base/Memory.h"
+#include "base/Vec3.h"
+
+/* Mantém carregados só os chunks perto do jogador. Os tiles vêm de um
+ * Level mapeado e as meshes são feitas pelo Builder em segundo plano, já
+ * que um chunk recém carregado fica sujo. Assim a memória depende do
+ * raio de visão e não do tamanho do mapa. */
+
+typedef struct {
+	/* Em chunks, medido como max(|dx|, |dy|) a partir do chunk do
+	 * jogador. Um chunk entra a até load_radius e só sai depois de
+	 * unload_radius, para não ficar entrando e saindo na fronteira. */
+	int load_radius;
+	int unload_radius;
+
+	/* Carrega também ao redor de onde o jogador estará daqui a tantos
+	 * segundos, mantendo a velocidade atual */
+	float prefetch_seconds;
+
+	/* Chunks carregados por Streamer_Update, para limitar o custo de um
+	 * quadro */
+	int max_loads;
+
+	/* Limites de memória: chunks com tiles na RAM e bytes de vértices na
+	 * GPU. Passando deles, um chunk só entra no lugar de outro mais
+	 * longe. Chunks ainda sem mesh contam pela média dos outros, então o
+	 * limite da GPU é aproximado. */
+	int max_chunks;
+	size_t max_mesh_bytes;
+} StreamerConfig;
+
+struct Streamer {
+	StreamerConfig config;
+	Level level;
+
+	size_t mesh_bytes;
+	size_t average_mesh_bytes;
+	size_t peak_mesh_bytes;
+	int peak_chunks;
+	int num_loads, num_evictions;
+};
+
+/* Abre o nível e cria o mundo com o tamanho e as luzes dele, cabendo só
+ * config->max_chunks chunks. O mundo começa vazio. */
+bool Streamer_Create(Streamer *streamer, Memory *memory, World *world, const char *filename, const StreamerConfig *config);
+
+/* Descarta os chunks longe de position e carrega os que faltam perto
+ * dele, os mais próximos primeiro. */
+void Streamer_Update(Streamer *streamer, World *world, const Vec3 *position, const Vec3 *velocity);
+
+void Streamer_PrintStats(const Streamer *streamer);
+
+void Streamer_Destroy(Streamer *streamer);
+
+#endif
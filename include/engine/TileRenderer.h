@@ -0,0 +1,41 @@
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include "engine/Types.h"
+#include "base/Memory.h"
+#include "base/Mat4.h"
+
+/* Caminho alternativo ao Builder: a grade de tiles vai inteira para uma
+ * textura e o vertex shader gera chão, teto, degraus e paredes de cada
+ * tile a partir de gl_VertexID e gl_InstanceID. Editar um tile custa
+ * 16 bytes de glTexSubImage2D em vez de refazer a mesh do chunk.
+ *
+ * Cada tile ocupa dois texels RGBA16I:
+ *   (2i, j)     = bot_height, top_height, wall_type, wall_texture
+ *   (2i + 1, j) = bot_texture, top_texture, bot_window_texture, top_window_texture
+ * com as alturas em 1/PACKED_VERTEX_SCALE de tile. */
+
+#define TILE_RENDERER_TEXELS_PER_TILE 2
+
+/* Chão, teto, 4 degraus de baixo, 4 de cima e até 4 faces de parede */
+#define TILE_RENDERER_FACES_PER_TILE 14
+#define TILE_RENDERER_VERTICES_PER_TILE ( TILE_RENDERER_FACES_PER_TILE * 6 )
+
+struct TileRenderer {
+	unsigned int tile_texture;
+	unsigned int vao;
+
+	Shader shader;
+};
+
+/* Sobe a grade inteira, usando stack como rascunho, e carrega o shader */
+bool TileRenderer_Create(TileRenderer *renderer, Memory *stack, const World *world);
+
+/* Reenvia um único tile depois de um World_EditTile */
+void TileRenderer_UpdateTile(TileRenderer *renderer, const World *world, int i, int j);
+
+void TileRenderer_Render(const TileRenderer *renderer, const World *world, const Mat4 *view, const Mat4 *projection);
+
+void TileRenderer_Destroy(TileRenderer *renderer);
+
+#endif
@@ -5,36 +5,62 @@
 #include "renderer/Mesh.h"
 #include "renderer/Texture.h"
 #include "base/Context.h"
+#include "base/FrameMemory.h"
+#include "base/Pool.h"
 
-#define WORLD_SIZE 256
+/* O tamanho do mundo é escolhido no World_Create; só o chunk é fixo */
 #define CHUNK_SIZE 64
-#define NUM_CHUNKS (WORLD_SIZE / CHUNK_SIZE)
+
+/* O LOD n junta blocos de 2^n x 2^n tiles */
+#define CHUNK_NUM_LODS 3
+
+/* Até quantos tiles além da borda a mesh de um chunk depende: a sombra
+ * de uma luz vai até o raio dela, e a borda do LOD mais grosso junta um
+ * bloco inteiro do vizinho, que é menor */
+#define CHUNK_BUILD_REACH WORLD_MAX_LIGHT_RADIUS
+
+/* Luzes estáticas do nível, assadas nos vértices pelo builder. O raio
+ * é limitado para que a sombra caiba no que o builder copia. */
+#define WORLD_MAX_LIGHTS 256
+#define WORLD_MAX_LIGHT_RADIUS 16
 
 #define MAX_TAGS 64
 #define MAX_ENTITIES 256
 
 typedef struct Game Game;
 typedef struct Entity Entity;
+typedef struct Builder Builder;
+typedef struct TileRenderer TileRenderer;
+typedef struct Streamer Streamer;
+typedef struct Level Level;
+
+/* Uma linha por tipo de parede: o enum abaixo e a tabela wall_shapes de
+ * WallShape.h são gerados daqui, então um tipo novo é só uma entrada.
+ * Caixas usam offset e size em fração do tile; diagonais usam o canto
+ * ocupado (bit 0 em x, bit 1 em z). */
+#define WALLTYPE_TABLE(X) \
+	X(WALLTYPE_NONE,               WALLSHAPE_EMPTY,    0.0f,  0.0f,  0.0f, 0.0f, 0) \
+	X(WALLTYPE_BLOCK,              WALLSHAPE_BOX,      0.0f,  0.0f,  1.0f, 1.0f, 0) \
+	X(WALLTYPE_HALFBLOCK_LEFT,     WALLSHAPE_BOX,      0.0f,  0.0f,  0.5f, 1.0f, 0) \
+	X(WALLTYPE_HALFBLOCK_RIGHT,    WALLSHAPE_BOX,      0.5f,  0.0f,  0.5f, 1.0f, 0) \
+	X(WALLTYPE_HALFBLOCK_UP,       WALLSHAPE_BOX,      0.0f,  0.5f,  1.0f, 0.5f, 0) \
+	X(WALLTYPE_HALFBLOCK_DOWN,     WALLSHAPE_BOX,      0.0f,  0.0f,  1.0f, 0.5f, 0) \
+	X(WALLTYPE_HALFBLOCK_MIDDLE,   WALLSHAPE_BOX,      0.25f, 0.25f, 0.5f, 0.5f, 0) \
+	X(WALLTYPE_DIAGONAL_DOWNLEFT,  WALLSHAPE_DIAGONAL, 0.0f,  0.0f,  1.0f, 1.0f, 0) \
+	X(WALLTYPE_DIAGONAL_DOWNRIGHT, WALLSHAPE_DIAGONAL, 0.0f,  0.0f,  1.0f, 1.0f, 1) \
+	X(WALLTYPE_DIAGONAL_UPLEFT,    WALLSHAPE_DIAGONAL, 0.0f,  0.0f,  1.0f, 1.0f, 2) \
+	X(WALLTYPE_DIAGONAL_UPRIGHT,   WALLSHAPE_DIAGONAL, 0.0f,  0.0f,  1.0f, 1.0f, 3)
+
+#define WALLTYPE_ENUM_ENTRY(type, kind, offset_x, offset_z, size_x, size_z, corner) type,
 
 typedef enum {
-	WALLTYPE_NONE = 0,
-	WALLTYPE_BLOCK,
-	WALLTYPE_HALFBLOCK_LEFT,
-	WALLTYPE_HALFBLOCK_RIGHT,
-	WALLTYPE_HALFBLOCK_UP,
-	WALLTYPE_HALFBLOCK_DOWN,
-
-	WALLTYPE_HALFBLOCK_MIDDLE,
-
-
-	WALLTYPE_DIAGONAL_DOWNLEFT,
-	WALLTYPE_DIAGONAL_DOWNRIGHT,
-	WALLTYPE_DIAGONAL_UPLEFT,
-	WALLTYPE_DIAGONAL_UPRIGHT,
+	WALLTYPE_TABLE(WALLTYPE_ENUM_ENTRY)
 
 	WALLTYPE_NUMTYPES
 } WallType;
 
+#undef WALLTYPE_ENUM_ENTRY
+
 typedef struct {
 	float bot_height;
 	int bot_window_texture;
@@ -49,16 +75,96 @@ typedef struct {
 	WallType wall_type;
 } Tile;
 
+/* Alturas guardadas em 1/TILE_HEIGHT_SCALE de tile. Os vértices já usam
+ * essa precisão, então nada mais fino chegaria à tela. */
+#define TILE_HEIGHT_SCALE PACKED_VERTEX_SCALE
+
+/* Tile como fica guardado no chunk. Texturas são índices da TextureArray,
+ * que tem bem menos de 256 camadas. Só World_GetTile e World_EditTile
+ * convertem entre este formato e Tile. */
+typedef struct {
+	int16_t bot_height;
+	int16_t top_height;
+
+	uint8_t bot_texture;
+	uint8_t bot_window_texture;
+	uint8_t top_texture;
+	uint8_t top_window_texture;
+	uint8_t wall_texture;
+
+	uint8_t wall_type;
+} PackedTile;
+
+/* Blocos que cobrem o tile inteiro e tiles sem espaço entre chão e teto
+ * fazem sombra. A sombra é testada só no plano xz: meias paredes e
+ * diagonais deixam a luz passar, e a altura da luz não conta. */
+typedef struct {
+	Vec3 position;
+	Vec3 color;
+
+	/* Até WORLD_MAX_LIGHT_RADIUS tiles */
+	float radius;
+} WorldLight;
+
+/* Entidades que o nível cria ao começar */
+typedef enum {
+	LEVEL_SPAWN_PLAYER = 0,
+	LEVEL_SPAWN_NUMTYPES
+} LevelSpawnType;
+
+typedef struct {
+	uint32_t type;
+	Vec3 position;
+	float angle;
+} LevelSpawn;
+
+/* Cópia da borda dos vizinhos: duas linhas de CHUNK_SIZE + 2 tiles, com
+ * os cantos, e duas colunas de CHUNK_SIZE */
+#define CHUNK_APRON_SIZE ( 4 * CHUNK_SIZE + 4 )
+
 typedef struct { 
-	Tile tiles[CHUNK_SIZE * CHUNK_SIZE];
-	Mesh mesh;
+	/* Em ordem Z (Morton), para vizinhos em x e em z ficarem perto */
+	PackedTile tiles[CHUNK_SIZE * CHUNK_SIZE];
+
+	/* Só leitura, atualizada por World_EditTile. Fora do mundo guarda
+	 * colunas sólidas. */
+	PackedTile apron[CHUNK_APRON_SIZE];
+
+	/* Canto do chunk em tiles, índice na grade de chunks do mundo e
+	 * posição na lista World.chunks */
+	int x, y;
+	int index;
+	int slot;
+
+	Mesh lods[CHUNK_NUM_LODS];
+	int lod;
 	bool dirty;
+	int revision;
 } Chunk;
 
 typedef struct {
-	Chunk chunks[NUM_CHUNKS * NUM_CHUNKS];
-	Tile tiles[WORLD_SIZE * WORLD_SIZE];
-	Mesh chunk_meshes[NUM_CHUNKS * NUM_CHUNKS];
+	/* Em tiles, múltiplos de CHUNK_SIZE */
+	int width, height;
+	int chunks_x, chunks_y;
+
+	/* Só existem os chunks que receberam algum tile, alocados de
+	 * chunk_pool. chunks é a lista para percorrer todos; chunk_map acha
+	 * um chunk pelo índice na grade, com endereçamento aberto. Chunks
+	 * que faltam são sólidos. */
+	Pool chunk_pool;
+	Chunk **chunks;
+	int num_chunks, max_chunks;
+	Chunk **chunk_map;
+	int chunk_map_size;
+
+	/* Cresce a cada chunk mandado ao builder, para que um resultado
+	 * antigo nunca valha para um chunk que foi refeito */
+	int last_revision;
+
+	WorldLight lights[WORLD_MAX_LIGHTS];
+	int num_lights;
+	Vec3 ambient_light;
+
 	TextureArray tile_textures;
 	Shader shader;
 
@@ -93,10 +199,21 @@ struct Entity {
 
 struct Game {
 	Context *context;
+	FrameMemory frame;
 	World world;
+	Builder *builder;
+	TileRenderer *tile_renderer;
+	Streamer *streamer;
 
 	Entity entities[MAX_ENTITIES];
 
+	/* Os chunks são carregados ao redor dele */
+	Entity *player;
+
+	/* Copiados do nível, para o main criar as entidades */
+	LevelSpawn *spawns;
+	int num_spawns;
+
 	Mat4 view;
 	Mat4 projection;
 
@@ -0,0 +1,39 @@
+#ifndef WALLSHAPE_H
+#define WALLSHAPE_H
+
+#include "engine/Types.h"
+#include "base/Vec3.h"
+
+typedef enum {
+	WALLSHAPE_EMPTY = 0,
+	WALLSHAPE_BOX,
+	WALLSHAPE_DIAGONAL
+} WallShapeKind;
+
+/* Formato de um tipo de parede, gerado de WALLTYPE_TABLE em Types.h.
+ * Builder, colisão e TileRenderer leem daqui em vez de cada um ter o seu
+ * switch. */
+typedef struct {
+	WallShapeKind kind;
+
+	/* Caixa ocupada, em fração do tile */
+	float offset_x, offset_z;
+	float size_x, size_z;
+
+	/* Diagonais: canto ocupado (bit 0 em x, bit 1 em z) e se a face vai
+	 * de (1, 0) a (0, 1) */
+	int corner;
+	bool down_to_top;
+
+	/* Semi-espaço livre da diagonal: plane passa pela face e normal
+	 * aponta para longe do canto ocupado */
+	Vec3 plane;
+	Vec3 normal;
+} WallShape;
+
+extern const WallShape wall_shapes[WALLTYPE_NUMTYPES];
+
+/* Tipos desconhecidos, vindos de um nível corrompido, viram blocos */
+const WallShape *WallShape_Get(WallType wall_type);
+
+#endif
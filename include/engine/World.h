@@ -4,14 +4,66 @@
 #include "engine/Types.h"
 #include "base/Mat4.h"
 
-#define World_GetChunkIndex(i, j) ((i / CHUNK_SIZE) + (j / CHUNK_SIZE) * NUM_CHUNKS)
-#define Chunk_GetTileIndex(i, j) ((i % CHUNK_SIZE) + (j % CHUNK_SIZE) * CHUNK_SIZE)
+#include "base/Memory.h"
 
-const Tile * World_GetTile(const World *world, int i, int j);
+#define World_GetChunkIndex(world, i, j) ((i) / CHUNK_SIZE + (j) / CHUNK_SIZE * (world)->chunks_x)
 
+/* Intercala os bits de x com zeros; serve para CHUNK_SIZE até 256 */
+#define Chunk_SpreadBits(x) ( \
+		((x) & 0x01) | ((x) & 0x02) << 1 | ((x) & 0x04) << 2 | ((x) & 0x08) << 3 | \
+		((x) & 0x10) << 4 | ((x) & 0x20) << 5 | ((x) & 0x40) << 6 | ((x) & 0x80) << 7 \
+		)
+
+#define Chunk_GetTileIndex(i, j) ( Chunk_SpreadBits((i) % CHUNK_SIZE) | Chunk_SpreadBits((j) % CHUNK_SIZE) << 1 )
+
+/* O tamanho, em tiles, é arredondado para múltiplos de CHUNK_SIZE. Cabem
+ * até max_chunks chunks ao mesmo tempo, com a memória saindo de memory. */
+bool World_Create(World *world, Memory *memory, int width, int height, int max_chunks);
+
+/* Descarta todos os chunks, suas meshes e as luzes */
+void World_Clear(World *world);
+
+/* NULL se o chunk não existe */
+Chunk * World_GetChunk(const World *world, int index);
+
+/* Copia o tile para tile. Fora do mundo retorna false, e o tile deve
+ * ser tratado como sólido. */
+bool World_GetTile(const World *world, int i, int j, Tile *tile);
+
+/* Acesso sem checagem para laços internos: i e j são relativos ao chunk
+ * e vão de -1 a CHUNK_SIZE, onde -1 e CHUNK_SIZE caem na borda copiada
+ * dos vizinhos */
+const PackedTile * Chunk_GetTile(const Chunk *chunk, int i, int j);
+
+void World_UnpackTile(Tile *tile, const PackedTile *packed);
+
+/* Tile em coordenadas do mundo. Fora do mundo ou num chunk que falta é
+ * a coluna sólida que a borda copiada também guarda. */
+const PackedTile * World_GetPackedTile(const World *world, int i, int j);
+
+/* Marca como sujo o chunk do tile e os vizinhos a até CHUNK_BUILD_REACH
+ * tiles dele, já que o builder lê os tiles do outro lado da borda. Falha
+ * se o tile não cabe em PackedTile. */
 bool World_EditTile(World *world, int i, int j, const Tile *tile);
 
-void World_Render(const World *world, const Mat4 *view, const Mat4 *projection);
+/* Cria o chunk, se faltar, com os tiles dados em ordem Z e marca como
+ * sujos ele e os vizinhos. NULL se não cabe mais nenhum chunk. */
+Chunk * World_LoadChunk(World *world, int index, const PackedTile *tiles);
+
+/* Libera o chunk, seus tiles e suas meshes. Para os vizinhos ele volta a
+ * ser sólido. */
+void World_FreeChunk(World *world, int index);
+
+/* Adiciona uma luz estática e marca como sujos os chunks que ela alcança.
+ * Falha com mais de WORLD_MAX_LIGHTS luzes ou raio fora de
+ * (0, WORLD_MAX_LIGHT_RADIUS]. */
+bool World_AddLight(World *world, const Vec3 *position, const Vec3 *color, float radius);
+
+/* Se a luz chega a algum ponto do chunk, no plano xz */
+bool World_LightReachesChunk(const WorldLight *light, const Chunk *chunk);
+
+/* Escolhe o LOD de cada chunk pela distância até a câmera */
+void World_Render(World *world, const Mat4 *view, const Mat4 *projection);
 
 bool World_CheckCollisionBox(const World *world, const Vec3 *position, const Vec3 *size);
 
@@ -19,15 +19,57 @@ typedef struct {
 	float layer_index;
 } Vertex;
 
+/* Vértice compacto dos chunks do mundo, com 16 bytes.
+ * Posições e uvs ficam em 1/PACKED_VERTEX_SCALE de tile, com x e z
+ * relativos à origem do chunk. */
+#define PACKED_VERTEX_SCALE 16
+
+typedef enum {
+	PACKED_NORMAL_NONE = 0,
+	PACKED_NORMAL_POSITIVE_X,
+	PACKED_NORMAL_NEGATIVE_X,
+	PACKED_NORMAL_POSITIVE_Y,
+	PACKED_NORMAL_NEGATIVE_Y,
+	PACKED_NORMAL_POSITIVE_Z,
+	PACKED_NORMAL_NEGATIVE_Z,
+	PACKED_NORMAL_DIAGONAL_PP,
+	PACKED_NORMAL_DIAGONAL_PN,
+	PACKED_NORMAL_DIAGONAL_NP,
+	PACKED_NORMAL_DIAGONAL_NN,
+	PACKED_NORMAL_NUMNORMALS
+} PackedNormal;
+
+typedef struct {
+	int16_t x, y, z;
+	uint8_t normal;
+	uint8_t layer_index;
+	int16_t u, v;
+	uint8_t color[4];
+} PackedVertex;
+
+/* Meshes de quads compartilham um único index buffer de 16 bits. Como
+ * cada quad usa 4 vértices, um desenho cobre no máximo 16384 quads e as
+ * meshes maiores são desenhadas em sub-meshes com glDrawElementsBaseVertex. */
+#define MESH_QUADS_PER_BATCH 16384
+
 typedef struct {
 	unsigned int vao, vbo, ebo;
 	unsigned int num_indices;
+	unsigned int num_quads;
 } Mesh;
 
 bool Vertex_CreateSimple(Vertex *vertex, float x, float y, float z, float u, float v);
 
+bool PackedVertex_Create(PackedVertex *vertex, float x, float y, float z, float u, float v, int layer_index);
+
 bool Mesh_Create(Mesh *mesh, const Vertex *vertices, size_t num_vertices, const unsigned int *indices, size_t num_indices);
 
+/* Os vértices vêm em grupos de 4, um grupo por quad */
+bool Mesh_CreatePacked(Mesh *mesh, const PackedVertex *vertices, size_t num_vertices);
+
+/* Troca os vértices de uma mesh de quads, criando a mesh se vao == 0 */
+bool Mesh_UpdatePacked(Mesh *mesh, const PackedVertex *vertices, size_t num_vertices);
+
 bool Mesh_BuildUnitTetrahedron(Mesh *mesh);
 
 bool Mesh_Render(const Mesh *mesh, const Shader *shader);
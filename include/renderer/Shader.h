@@ -2,6 +2,7 @@
 #define SHADER_H
 
 #include "base/Mat4.h"
+#include "base/Memory.h"
 
 typedef struct {
 	unsigned int id;
@@ -9,6 +10,13 @@ typedef struct {
 
 bool Shader_Load(Shader *shader, const char *vertex_src, const char *fragment_src);
 
+/* Para fontes que não terminam em '\0', como arquivos mapeados.
+ * Um tamanho negativo equivale a Shader_Load. */
+bool Shader_LoadWithLength(Shader *shader, const char *vertex_src, int vertex_length, const char *fragment_src, int fragment_length);
+
+/* Lê os dois arquivos usando stack como rascunho */
+bool Shader_LoadFiles(Shader *shader, Memory *stack, const char *vertex_filename, const char *fragment_filename);
+
 void Shader_Use(const Shader *shader);
 
 bool Shader_SetUniform1i(const Shader *shader, const char *name, int i);
@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec3 uv;
+in vec4 color;
+
+uniform sampler2DArray tex_array;
+
+out vec4 frag_color;
+
+void main(){
+	vec4 texel = texture(tex_array, uv);
+
+	if(texel.a < 0.5)
+		discard;
+
+	frag_color = texel * color;
+}
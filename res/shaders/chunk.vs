@@ -0,0 +1,26 @@
+#version 330 core
+
+layout (location = 0) in ivec3 in_position;
+layout (location = 1) in ivec2 in_uv;
+layout (location = 2) in uint in_normal;
+layout (location = 3) in vec4 in_color;
+layout (location = 4) in uint in_layer_index;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 chunk_origin;
+
+out vec3 uv;
+out vec4 color;
+
+/* Deve ser igual a PACKED_VERTEX_SCALE em Mesh.h */
+const float packed_scale = 16.0;
+
+void main(){
+	vec3 position = vec3(in_position) / packed_scale + chunk_origin;
+
+	gl_Position = projection * view * model * vec4(position, 1.0);
+	uv = vec3(vec2(in_uv) / packed_scale, float(in_layer_index));
+	color = in_color;
+}
@@ -0,0 +1,245 @@
+#version 330 core
+
+/* Gera as faces de um tile por instância, sem vertex buffer. O formato de
+ * tile_data e a ordem das faces estão em TileRenderer.h */
+
+uniform isampler2D tile_data;
+uniform int world_width;
+uniform int world_height;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 ambient_light;
+
+/* Um elemento por WallType, preenchidos pelo TileRenderer a partir de
+ * wall_shapes. O tamanho deve ser TILE_RENDERER_SHADER_WALLTYPES */
+uniform vec4 wall_boxes[11];
+uniform int wall_diagonals[11];
+
+out vec3 uv;
+out vec4 color;
+
+/* Deve ser igual a PACKED_VERTEX_SCALE em Mesh.h */
+const float packed_scale = 16.0;
+
+const int WALLTYPE_NONE = 0;
+const int WALLTYPE_BLOCK = 1;
+
+/* Ordem dos cantos nos dois triângulos, igual ao index buffer das meshes */
+const int quad_corners[6] = int[6](2, 1, 3, 2, 1, 0);
+
+/* Bordas na ordem do Builder: esquerda, direita, baixo, cima */
+const ivec2 edge_steps[4] = ivec2[4](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));
+
+struct TileData {
+	bool valid;
+	float bot_height, top_height;
+	int wall_type, wall_texture;
+	int bot_texture, top_texture;
+	int bot_window_texture, top_window_texture;
+};
+
+struct Face {
+	vec3 position;
+	vec3 add;
+	int layer;
+	bool diagonal;
+};
+
+TileData fetch_tile(ivec2 tile){
+	TileData data = TileData(false, 0.0, 0.0, WALLTYPE_BLOCK, 0, 0, 0, 0, 0);
+
+	if(any(lessThan(tile, ivec2(0))) || any(greaterThanEqual(tile, ivec2(world_width, world_height))))
+		return data;
+
+	ivec4 a = texelFetch(tile_data, ivec2(tile.x * 2, tile.y), 0);
+	ivec4 b = texelFetch(tile_data, ivec2(tile.x * 2 + 1, tile.y), 0);
+
+	data.valid = true;
+	data.bot_height = float(a.x) / packed_scale;
+	data.top_height = float(a.y) / packed_scale;
+	data.wall_type = a.z;
+	data.wall_texture = a.w;
+	data.bot_texture = b.x;
+	data.top_texture = b.y;
+	data.bot_window_texture = b.z;
+	data.top_window_texture = b.w;
+
+	return data;
+}
+
+/* Fora do mundo e blocos inteiros escondem a face da borda. Ao contrário
+ * do Builder, meias paredes vizinhas não são consideradas. */
+bool edge_hidden(ivec2 tile, int edge){
+	TileData neighbour = fetch_tile(tile + edge_steps[edge]);
+
+	return !neighbour.valid || neighbour.wall_type == WALLTYPE_BLOCK || neighbour.top_height <= neighbour.bot_height;
+}
+
+bool step_face(int index, ivec2 tile, TileData data, out Face face){
+	int edge = index % 4;
+	bool top = index >= 4;
+	TileData other = fetch_tile(tile + edge_steps[edge]);
+	float y, height;
+
+	if(!other.valid)
+		return false;
+
+	/* Cada degrau pertence ao tile mais alto, como no Builder */
+	if(top) {
+		y = data.top_height;
+		height = other.top_height - data.top_height;
+		face.layer = data.top_window_texture;
+
+		if(height <= 0.0)
+			return false;
+	}
+	else {
+		y = data.bot_height;
+		height = other.bot_height - data.bot_height;
+		face.layer = data.bot_window_texture;
+
+		if(height >= 0.0)
+			return false;
+	}
+
+	face.diagonal = false;
+	face.position = vec3(tile.x + (edge == 1 ? 1 : 0), y, tile.y + (edge == 3 ? 1 : 0));
+	face.add = edge < 2 ? vec3(0.0, height, 1.0) : vec3(1.0, height, 0.0);
+
+	return true;
+}
+
+bool wall_face(int index, ivec2 tile, TileData data, out Face face){
+	float height = data.top_height - data.bot_height;
+	int diagonal = wall_diagonals[data.wall_type];
+	vec4 box = wall_boxes[data.wall_type];
+
+	if(data.wall_type == WALLTYPE_NONE || height <= 0.0)
+		return false;
+
+	face.layer = data.wall_texture;
+	face.diagonal = false;
+
+	if(diagonal >= 0) {
+		float add_x = (diagonal & 1) != 0 ? 1.0 : 0.0;
+		float add_z = (diagonal & 2) != 0 ? 1.0 : 0.0;
+
+		if(index == 0) {
+			face.position = vec3(tile.x + add_x, data.bot_height, tile.y);
+			face.add = vec3(0.0, height, 1.0);
+			return !edge_hidden(tile, add_x != 0.0 ? 1 : 0);
+		}
+
+		if(index == 1) {
+			face.position = vec3(tile.x, data.bot_height, tile.y + add_z);
+			face.add = vec3(1.0, height, 0.0);
+			return !edge_hidden(tile, add_z != 0.0 ? 3 : 2);
+		}
+
+		if(index == 2) {
+			face.diagonal = true;
+
+			if((diagonal & 4) != 0) {
+				face.position = vec3(tile.x + 1.0, data.bot_height, tile.y);
+				face.add = vec3(-1.0, height, 1.0);
+			}
+			else {
+				face.position = vec3(tile.x, data.bot_height, tile.y);
+				face.add = vec3(1.0, height, 1.0);
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	vec2 start = vec2(tile) + box.xy;
+
+	/* Esquerda, baixo, direita e cima, como em Builder_BuildTileWallBlock */
+	if(index == 0) {
+		face.position = vec3(start.x, data.bot_height, start.y);
+		face.add = vec3(0.0, height, box.w);
+		return box.x != 0.0 || !edge_hidden(tile, 0);
+	}
+
+	if(index == 1) {
+		face.position = vec3(start.x, data.bot_height, start.y);
+		face.add = vec3(box.z, height, 0.0);
+		return box.y != 0.0 || !edge_hidden(tile, 2);
+	}
+
+	if(index == 2) {
+		face.position = vec3(start.x + box.z, data.bot_height, start.y);
+		face.add = vec3(0.0, height, box.w);
+		return box.x + box.z != 1.0 || !edge_hidden(tile, 1);
+	}
+
+	face.position = vec3(start.x, data.bot_height, start.y + box.w);
+	face.add = vec3(box.z, height, 0.0);
+	return box.y + box.w != 1.0 || !edge_hidden(tile, 3);
+}
+
+bool tile_face(int index, ivec2 tile, out Face face){
+	TileData data = fetch_tile(tile);
+
+	face = Face(vec3(0.0), vec3(0.0), 0, false);
+
+	/* 0: chão, 1: teto, 2-9: degraus, 10-13: paredes */
+	if(index < 2) {
+		if(data.top_height <= data.bot_height)
+			return false;
+
+		face.position = vec3(tile.x, index == 0 ? data.bot_height : data.top_height, tile.y);
+		face.add = vec3(1.0, 0.0, 1.0);
+		face.layer = index == 0 ? data.bot_texture : data.top_texture;
+		return true;
+	}
+
+	if(index < 10)
+		return step_face(index - 2, tile, data, face);
+
+	return wall_face(index - 10, tile, data, face);
+}
+
+void main(){
+	ivec2 tile = ivec2(gl_InstanceID % world_width, gl_InstanceID / world_width);
+	int corner = quad_corners[gl_VertexID % 6];
+	bool u_corner = (corner & 1) != 0;
+	bool v_corner = (corner & 2) != 0;
+	vec3 offset;
+	vec2 face_uv;
+	Face face;
+
+	color = vec4(ambient_light, 1.0);
+
+	/* Faces ausentes viram triângulos fora do volume de recorte */
+	if(!tile_face(gl_VertexID / 6, tile, face)) {
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		uv = vec3(0.0);
+		return;
+	}
+
+	/* Mesmos cantos e uvs de Builder_BuildPlane e Builder_BuildPlaneDiagonal */
+	if(face.diagonal) {
+		offset = vec3(u_corner ? face.add.x : 0.0, v_corner ? face.add.y : 0.0, u_corner ? face.add.z : 0.0);
+		face_uv = vec2(u_corner ? 1.0 : 0.0, offset.y);
+	}
+	else if(face.add.x == 0.0) {
+		offset = vec3(0.0, u_corner ? face.add.y : 0.0, v_corner ? face.add.z : 0.0);
+		face_uv = (face.position + offset).zy;
+	}
+	else if(face.add.y == 0.0) {
+		offset = vec3(u_corner ? face.add.x : 0.0, 0.0, v_corner ? face.add.z : 0.0);
+		face_uv = (face.position + offset).xz;
+	}
+	else {
+		offset = vec3(u_corner ? face.add.x : 0.0, v_corner ? face.add.y : 0.0, 0.0);
+		face_uv = (face.position + offset).xy;
+	}
+
+	gl_Position = projection * view * model * vec4(face.position + offset, 1.0);
+	uv = vec3(face_uv, float(face.layer));
+}
@@ -17,7 +17,7 @@ Context *Context_Create(const char *title, int w, int h, Memory *memory, Memory
 
 	Context *context;
 
-	context = (Context *) Memory_Alloc(memory, sizeof(Context));
+	context = (Context *) Memory_AllocTagged(memory, sizeof(Context), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_CONTEXT);
 
 	context->window = SDL_CreateWindow(
 			title,
@@ -51,8 +51,8 @@ Context *Context_Create(const char *title, int w, int h, Memory *memory, Memory
 	context->dt = 0.0f;
 	context->min_time_frame = 0;
 
-	context->key_mapping = Memory_Alloc(memory, sizeof(int) * NUM_KEYS);
-	context->button_mapping = Memory_Alloc(memory, sizeof(int) * NUM_KEYS);
+	context->key_mapping = Memory_AllocTagged(memory, sizeof(int) * NUM_KEYS, MEMORY_DEFAULT_ALIGNMENT, MEMTAG_CONTEXT);
+	context->button_mapping = Memory_AllocTagged(memory, sizeof(int) * NUM_KEYS, MEMORY_DEFAULT_ALIGNMENT, MEMTAG_CONTEXT);
 
 	Context_SetDefaultMapping(context);
 
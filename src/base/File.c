@@ -0,0 +1,117 @@
+#include "base/File.h"
+
+#include <stdio.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FILE_HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool File_Map(FileView *view, const char *filename, FileAccess access) {
+#ifdef FILE_HAS_MMAP
+	struct stat info;
+	void *data;
+	int fd;
+
+	view->data = NULL;
+	view->size = 0;
+	view->mapped = false;
+
+	fd = open(filename, O_RDONLY);
+
+	if(fd < 0)
+		return false;
+
+	if(fstat(fd, &info) < 0 || info.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(data == MAP_FAILED)
+		return false;
+
+	if(access == FILE_ACCESS_SEQUENTIAL)
+		madvise(data, (size_t) info.st_size, MADV_SEQUENTIAL);
+	else if(access == FILE_ACCESS_RANDOM)
+		madvise(data, (size_t) info.st_size, MADV_RANDOM);
+
+	view->data = (const char *) data;
+	view->size = (size_t) info.st_size;
+	view->mapped = true;
+
+	return true;
+#else
+	(void) view;
+	(void) filename;
+	(void) access;
+
+	return false;
+#endif
+}
+
+bool File_Read(FileView *view, Memory *mems, const char *filename) {
+	FILE *file;
+	char *str;
+	long size;
+
+	view->data = NULL;
+	view->size = 0;
+	view->mapped = false;
+
+	file = fopen(filename, "rb");
+
+	if(file == NULL)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if(size < 0) {
+		fclose(file);
+		return false;
+	}
+
+	str = (char *) Memory_Alloc(mems, (size_t) size + 1);
+
+	if(str == NULL) {
+		fclose(file);
+		return false;
+	}
+
+	view->size = fread(str, 1, (size_t) size, file);
+	fclose(file);
+
+	str[view->size] = '\0';
+	view->data = str;
+
+	return true;
+}
+
+bool File_Open(FileView *view, Memory *mems, const char *filename, FileAccess access) {
+	if(File_Map(view, filename, access))
+		return true;
+
+	if(mems == NULL)
+		return false;
+
+	return File_Read(view, mems, filename);
+}
+
+void File_Release(FileView *view) {
+#ifdef FILE_HAS_MMAP
+	if(view->mapped)
+		munmap((void *) view->data, view->size);
+#endif
+
+	/* A memória lida com File_Read pertence à stack de quem chamou */
+	view->data = NULL;
+	view->size = 0;
+	view->mapped = false;
+}
@@ -0,0 +1,51 @@
+#include "base/FrameMemory.h"
+
+#include <stdio.h>
+
+bool FrameMemory_Create(FrameMemory *frame, Memory *mems, size_t size) {
+	for(int i = 0; i < 2; i++) {
+		void *block = Memory_AllocTagged(mems, size, MEMORY_CACHE_LINE, MEMTAG_FRAME);
+
+		if(block == NULL)
+			return false;
+
+		frame->buffers[i] = Memory_Create(block, size);
+	}
+
+	frame->current = 0;
+	frame->frame = 0;
+	frame->high_water = 0;
+
+	return true;
+}
+
+void FrameMemory_Swap(FrameMemory *frame) {
+	Memory *finished = &frame->buffers[frame->current];
+
+	if(finished->top > frame->high_water) {
+		frame->high_water = finished->top;
+
+		if(frame->high_water > (size_t) (FRAME_MEMORY_WARNING_RATIO * finished->size)) {
+			fprintf(
+					stderr,
+					"Frame %lu used %lu of %lu KB of frame memory\n",
+					(unsigned long) frame->frame,
+					(unsigned long) (finished->top / 1024),
+					(unsigned long) (finished->size / 1024)
+					);
+		}
+	}
+
+	frame->current ^= 1;
+	frame->frame++;
+
+	Memory_Free(&frame->buffers[frame->current]);
+}
+
+void * FrameMemory_Alloc(FrameMemory *frame, size_t size) {
+	return Memory_Alloc(&frame->buffers[frame->current], size);
+}
+
+void * FrameMemory_AllocAligned(FrameMemory *frame, size_t size, size_t alignment) {
+	return Memory_AllocAligned(&frame->buffers[frame->current], size, alignment);
+}
@@ -1,57 +1,358 @@
 #include "base/Memory.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MEMORY_HAS_MMAP
+#include <sys/mman.h>
+#endif
+
+static bool Memory_Commit(Memory *mems, size_t new_top);
+#ifdef MEMORY_DEBUG
+static void Memory_PlaceGuard(Memory *mems, size_t position);
+#endif
+
+static const char *tag_names[MEMTAG_NUMTAGS] = {
+	[MEMTAG_GENERAL] = "general",
+	[MEMTAG_CONTEXT] = "context",
+	[MEMTAG_GAME] = "game",
+	[MEMTAG_WORLD] = "world",
+	[MEMTAG_BUILDER] = "builder",
+	[MEMTAG_RENDERER] = "renderer",
+	[MEMTAG_ENTITIES] = "entities",
+	[MEMTAG_ASSETS] = "assets",
+	[MEMTAG_FRAME] = "frame",
+};
 
 Memory Memory_Create(void *block, size_t size) {
-	Memory mems = {block, size, 0};
+	Memory mems = {0};
+
+	mems.block = block;
+	mems.size = size;
+	mems.committed = size;
 
 	return mems;
 }
 
+bool Memory_Reserve(Memory *mems, size_t size, int flags) {
+	size_t granularity = MEMORY_COMMIT_GRANULARITY;
+	void *block = NULL;
+
+	*mems = Memory_Create(NULL, 0);
+
+#ifdef MEMORY_HAS_MMAP
+	int map_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+	if(flags & (MEMORY_HUGE_PAGES_TRANSPARENT | MEMORY_HUGE_PAGES_EXPLICIT)) {
+		granularity = MEMORY_HUGE_PAGE_SIZE;
+	}
+
+	size = (size + granularity - 1) & ~(granularity - 1);
+
+#ifdef MAP_HUGETLB
+	if(flags & MEMORY_HUGE_PAGES_EXPLICIT) {
+		/* Sem MAP_NORESERVE, para falhar aqui se o kernel não tiver
+		 * huge pages suficientes, e não depois com SIGBUS */
+		block = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if(block == MAP_FAILED) {
+			fprintf(stderr, "Huge pages not available, using normal pages\n");
+			block = NULL;
+		}
+	}
+#endif
+
+	if(block == NULL) {
+		char *base, *aligned;
+		size_t extra = granularity > MEMORY_COMMIT_GRANULARITY ? granularity : 0;
+
+		/* Reserva um pouco a mais para alinhar o início à huge page */
+		base = mmap(NULL, size + extra, PROT_NONE, map_flags, -1, 0);
+
+		if(base == MAP_FAILED)
+			return false;
+
+		if(extra != 0)
+			aligned = (char *) (((uintptr_t) base + extra - 1) & ~((uintptr_t) extra - 1));
+		else
+			aligned = base;
+
+		if(aligned > base)
+			munmap(base, aligned - base);
+
+		if(base + size + extra > aligned + size)
+			munmap(aligned + size, (base + size + extra) - (aligned + size));
+
+		block = aligned;
+
+#ifdef MADV_HUGEPAGE
+		if(flags & (MEMORY_HUGE_PAGES_TRANSPARENT | MEMORY_HUGE_PAGES_EXPLICIT))
+			madvise(block, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	mems->block = block;
+	mems->size = size;
+	mems->committed = 0;
+	mems->granularity = granularity;
+	mems->reserved = true;
+#else
+	(void) flags;
+	(void) granularity;
+
+	/* Sem memória virtual, a reserva inteira é alocada de uma vez */
+	block = malloc(size);
+
+	if(block == NULL)
+		return false;
+
+	*mems = Memory_Create(block, size);
+	mems->reserved = true;
+#endif
+
+	return true;
+}
+
+void Memory_Release(Memory *mems) {
+	if(!mems->reserved)
+		return;
+
+#ifdef MEMORY_HAS_MMAP
+	munmap(mems->block, mems->size);
+#else
+	free(mems->block);
+#endif
+
+	*mems = Memory_Create(NULL, 0);
+}
+
 void * Memory_Alloc(Memory *mems, size_t size) {
-	char *location;
+	return Memory_AllocTagged(mems, size, MEMORY_DEFAULT_ALIGNMENT, mems->tag);
+}
+
+void * Memory_AllocAligned(Memory *mems, size_t size, size_t alignment) {
+	return Memory_AllocTagged(mems, size, alignment, mems->tag);
+}
+
+void * Memory_AllocTagged(Memory *mems, size_t size, size_t alignment, MemoryTag tag) {
+	size_t padding, available, total;
+	MemoryTagStats *stats;
+	uintptr_t address;
+
+	if(alignment == 0 || (alignment & (alignment - 1)) != 0)
+		return NULL;
+
+	if(mems->top > mems->size || tag >= MEMTAG_NUMTAGS)
+		return NULL;
+
+	address = (uintptr_t) (mems->block + mems->top);
+	padding = (size_t) (-address & (alignment - 1));
+	available = mems->size - mems->top;
+
+	/* Verifica sem somar para não estourar size_t */
+	if(padding > available || size > available - padding)
+		return NULL;
+
+	total = padding + size;
+
+#ifdef MEMORY_DEBUG
+	size_t guard_padding = (size_t) (-(address + total) & (sizeof(size_t) - 1));
+	size_t guard_total = guard_padding + MEMORY_GUARD_SIZE + sizeof(size_t);
+
+	if(guard_total > available - total)
+		return NULL;
 
-	if(mems->top >= mems->size)
+	total += guard_total;
+#endif
+
+	if(mems->top + total > mems->committed && !Memory_Commit(mems, mems->top + total))
 		return NULL;
 
-	location = mems->block + mems->top;
-	mems->top += size;
+#ifdef MEMORY_DEBUG
+	Memory_PlaceGuard(mems, mems->top + padding + size + guard_padding);
+#endif
+
+	mems->top += total;
+
+	stats = &mems->tags[tag];
+	stats->live += total;
+	stats->count++;
 
-	return (void *) location;
+	if(stats->live > stats->peak)
+		stats->peak = stats->live;
+
+	return (void *) (address + padding);
+}
+
+MemoryTag Memory_SetTag(Memory *mems, MemoryTag tag) {
+	MemoryTag old_tag = mems->tag;
+
+	mems->tag = tag;
+
+	return old_tag;
 }
 
 void Memory_Free(Memory *mems) {
+	Memory_CheckGuards(mems, 0);
+
 	mems->top = 0;
+	mems->depth = 0;
+	mems->last_guard = 0;
+
+	for(int i = 0; i < MEMTAG_NUMTAGS; i++)
+		mems->tags[i].live = 0;
 }
 
 void * Memory_GetTop(Memory *mems) {
 	return (void *) (mems->block + mems->top);
 }
 
-size_t Memory_SaveState(Memory *mems) {
-	return mems->top;
+MemoryScope Memory_BeginScope(Memory *mems) {
+	MemoryScope scope;
+
+	scope.mems = mems;
+	scope.top = mems->top;
+	scope.depth = ++mems->depth;
+	scope.last_guard = mems->last_guard;
+
+	for(int i = 0; i < MEMTAG_NUMTAGS; i++)
+		scope.live[i] = mems->tags[i].live;
+
+	return scope;
 }
 
-void Memory_RestoreState(Memory *mems, size_t old_state) {
-	mems->top = old_state;
+bool Memory_EndScope(MemoryScope *scope) {
+	Memory *mems = scope->mems;
+
+	if(mems == NULL)
+		return false;
+
+	if(scope->depth != mems->depth) {
+		fprintf(stderr, "Memory scope closed out of order (depth %d, expected %d)\n", scope->depth, mems->depth);
+		return false;
+	}
+
+	Memory_CheckGuards(mems, scope->top);
+
+	mems->top = scope->top;
+	mems->depth--;
+	mems->last_guard = scope->last_guard;
+
+	for(int i = 0; i < MEMTAG_NUMTAGS; i++)
+		mems->tags[i].live = scope->live[i];
+
+	scope->mems = NULL;
+
+	return true;
 }
 
-const char * Memory_ReadFileAsString(Memory *mems, const char *filename) {
-	FILE *file = fopen(filename, "r");
-	char *str;
-	size_t size;
+bool Memory_CheckGuards(const Memory *mems, size_t from) {
+#ifdef MEMORY_DEBUG
+	size_t guard = mems->last_guard;
+	const unsigned char *bytes;
+
+	while(guard != 0 && guard - 1 >= from) {
+		bytes = (const unsigned char *) mems->block + guard - 1;
+
+		for(int i = 0; i < MEMORY_GUARD_SIZE; i++) {
+			if(bytes[i] != MEMORY_GUARD_BYTE) {
+				fprintf(stderr, "Memory guard at offset %lu was overwritten\n", (unsigned long) (guard - 1));
+				return false;
+			}
+		}
 
-	if(file == NULL)
+		memcpy(&guard, bytes + MEMORY_GUARD_SIZE, sizeof(size_t));
+	}
+#else
+	(void) mems;
+	(void) from;
+#endif
+
+	return true;
+}
+
+const MemoryTagStats * Memory_GetTagStats(const Memory *mems, MemoryTag tag) {
+	if(tag >= MEMTAG_NUMTAGS)
 		return NULL;
 
-	fseek(file, 0, SEEK_END);
-	size = ftell(file);
-	fseek(file, 0, SEEK_SET);
+	return &mems->tags[tag];
+}
+
+const char * Memory_GetTagName(MemoryTag tag) {
+	if(tag >= MEMTAG_NUMTAGS)
+		return "unknown";
+
+	return tag_names[tag];
+}
+
+void Memory_PrintReport(const Memory *mems, const char *name) {
+	const MemoryTagStats *stats;
+
+	printf(
+			"%s: %lu KB used, %lu KB committed, %lu KB reserved\n",
+			name,
+			(unsigned long) (mems->top / 1024),
+			(unsigned long) (mems->committed / 1024),
+			(unsigned long) (mems->size / 1024)
+			);
+
+	printf("  %-10s %10s %10s %10s\n", "tag", "live KB", "peak KB", "allocs");
+
+	for(int i = 0; i < MEMTAG_NUMTAGS; i++) {
+		stats = &mems->tags[i];
 
-	str = (char *) Memory_Alloc(mems, size + 1);
+		if(stats->count == 0)
+			continue;
+
+		printf(
+				"  %-10s %10lu %10lu %10lu\n",
+				tag_names[i],
+				(unsigned long) (stats->live / 1024),
+				(unsigned long) (stats->peak / 1024),
+				(unsigned long) stats->count
+				);
+	}
+}
+
+static bool Memory_Commit(Memory *mems, size_t new_top) {
+#ifdef MEMORY_HAS_MMAP
+	size_t new_committed;
+
+	if(!mems->reserved)
+		return false;
+
+	new_committed = (new_top + mems->granularity - 1) & ~(mems->granularity - 1);
+
+	if(new_committed > mems->size)
+		new_committed = mems->size;
+
+	if(mprotect(mems->block + mems->committed, new_committed - mems->committed, PROT_READ | PROT_WRITE) != 0) {
+		fprintf(stderr, "Failed to commit %lu KB of memory\n", (unsigned long) (new_committed / 1024));
+		return false;
+	}
+
+	mems->committed = new_committed;
+
+	return true;
+#else
+	(void) mems;
+	(void) new_top;
+
+	return false;
+#endif
+}
 
-	fread(str, 1, size, file);
+#ifdef MEMORY_DEBUG
+static void Memory_PlaceGuard(Memory *mems, size_t position) {
+	char *guard = mems->block + position;
 
-	str[size] = '\0';
+	/* O padrão vem antes do encadeamento, para que um estouro o atinja
+	 * primeiro */
+	memset(guard, MEMORY_GUARD_BYTE, MEMORY_GUARD_SIZE);
+	memcpy(guard + MEMORY_GUARD_SIZE, &mems->last_guard, sizeof(size_t));
 
-	return (const char *) str;
+	mems->last_guard = position + 1;
 }
+#endif
@@ -0,0 +1,125 @@
+#include "base/Pool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define Pool_GetSlotIndex(pool, ptr) ( (size_t) ((const char *) (ptr) - (pool)->block) / (pool)->slot_size )
+#define Pool_GetBitWords(num_slots) ( ((num_slots) + 31) / 32 )
+
+bool Pool_Create(Pool *pool, Memory *mems, size_t object_size, size_t num_slots) {
+	size_t slot_size;
+
+	if(object_size < sizeof(PoolSlot))
+		object_size = sizeof(PoolSlot);
+
+	/* Cada slot começa em uma linha de cache própria */
+	slot_size = (object_size + MEMORY_CACHE_LINE - 1) & ~((size_t) MEMORY_CACHE_LINE - 1);
+
+	if(num_slots == 0 || slot_size > (size_t) -1 / num_slots)
+		return false;
+
+	pool->block = Memory_AllocAligned(mems, slot_size * num_slots, MEMORY_CACHE_LINE);
+	pool->free_bits = Memory_AllocAligned(mems, Pool_GetBitWords(num_slots) * sizeof(uint32_t), MEMORY_DEFAULT_ALIGNMENT);
+
+	if(pool->block == NULL || pool->free_bits == NULL)
+		return false;
+
+	pool->slot_size = slot_size;
+	pool->num_slots = num_slots;
+
+	Pool_Reset(pool);
+
+	return true;
+}
+
+void * Pool_Alloc(Pool *pool) {
+	PoolSlot *slot = pool->free_list;
+	size_t index;
+
+	if(slot == NULL)
+		return NULL;
+
+	pool->free_list = slot->next;
+	index = Pool_GetSlotIndex(pool, slot);
+	pool->free_bits[index / 32] &= ~((uint32_t) 1 << index % 32);
+
+	pool->used++;
+	pool->num_allocs++;
+
+	if(pool->used > pool->peak)
+		pool->peak = pool->used;
+
+	return (void *) slot;
+}
+
+bool Pool_Free(Pool *pool, void *object) {
+	PoolSlot *slot = (PoolSlot *) object;
+	size_t index;
+
+	if(!Pool_Contains(pool, object))
+		return false;
+
+	/* Liberar de novo deixaria a lista livre circular */
+	index = Pool_GetSlotIndex(pool, object);
+
+	if(pool->free_bits[index / 32] & (uint32_t) 1 << index % 32)
+		return false;
+
+	pool->free_bits[index / 32] |= (uint32_t) 1 << index % 32;
+
+	slot->next = pool->free_list;
+	pool->free_list = slot;
+
+	pool->used--;
+	pool->num_frees++;
+
+	return true;
+}
+
+void Pool_Reset(Pool *pool) {
+	PoolSlot *slot;
+
+	pool->free_list = NULL;
+
+	/* Todos livres; os bits depois do último slot também ficam em 1,
+	 * mas nunca são lidos */
+	memset(pool->free_bits, 0xff, Pool_GetBitWords(pool->num_slots) * sizeof(uint32_t));
+
+	/* Monta a lista de trás para frente para que os primeiros slots
+	 * sejam entregues primeiro */
+	for(size_t i = pool->num_slots; i > 0; i--) {
+		slot = (PoolSlot *) (pool->block + (i - 1) * pool->slot_size);
+		slot->next = pool->free_list;
+		pool->free_list = slot;
+	}
+
+	pool->used = 0;
+	pool->peak = 0;
+	pool->num_allocs = 0;
+	pool->num_frees = 0;
+}
+
+bool Pool_Contains(const Pool *pool, const void *object) {
+	const char *ptr = (const char *) object;
+	size_t offset;
+
+	if(ptr < pool->block || ptr >= pool->block + pool->slot_size * pool->num_slots)
+		return false;
+
+	offset = (size_t) (ptr - pool->block);
+
+	return offset % pool->slot_size == 0;
+}
+
+void Pool_PrintStats(const Pool *pool, const char *name) {
+	printf(
+			"%s: %lu/%lu slots (%lu bytes each), peak %lu, %lu allocs, %lu frees\n",
+			name,
+			(unsigned long) pool->used,
+			(unsigned long) pool->num_slots,
+			(unsigned long) pool->slot_size,
+			(unsigned long) pool->peak,
+			(unsigned long) pool->num_allocs,
+			(unsigned long) pool->num_frees
+			);
+}
@@ -1,228 +1,1143 @@
 #include "engine/Builder.h" 
 #include "engine/World.h"
+#include "engine/ChunkCache.h"
+#include "engine/WallShape.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
+#define BUILDER_MAX_WORKERS 16
+#define BUILDER_MAX_BACKGROUND_WORKERS 4
+#define BUILDER_SCRATCH_MEMORY ( 4 * 1024 * 1024 )
+
+/* Chunks esperando um worker. Os que passarem disso continuam sujos e
+ * entram na fila nos próximos quadros. */
+#define BUILDER_MAX_PENDING 32
+
+/* Quanto a oclusão escurece a luz ambiente quando o vértice está
+ * totalmente cercado */
+#define BUILDER_AO_STRENGTH 0.5f
+
+typedef struct BuilderTiles BuilderTiles;
+
+/* Com vertices == NULL o contexto só conta os vértices, para que a
+ * segunda passada escreva numa memória do tamanho exato */
 typedef struct {
-	Vertex *vertices;
+	PackedVertex *vertices;
 	size_t vcount;
 	size_t max_vertices;
-	unsigned int *indices;
-	size_t icount;
-	size_t max_indices;
+
+	/* Os vértices são guardados relativos ao canto do chunk. Nos LODs
+	 * cada tile da grade vale scale tiles do mundo em x e z. */
+	float origin_x, origin_z;
+	float scale;
+
+	/* Usados para assar a luz e a oclusão nos vértices */
+	const BuilderTiles *tiles;
 } BuilderContext;
 
-typedef struct BuilderRule {
-	void (*buildwall)(BuilderContext *, const World *, int, int, const struct BuilderRule *);
-	Vec3 offset;
-	Vec3 size;
-
-	int diagonal_wall_flag;
-	bool diagonal_down_to_top;
-} BuilderRule;
-
-static void Builder_BuildChunk(Mesh *mesh, Memory *stack, const World *world, int x, int y);
-static void Builder_AllocVertices(BuilderContext *context, size_t num_vertices);
-static void Builder_AllocIndices(BuilderContext *context, size_t num_indices);
-
-static void Builder_BuildTileX(BuilderContext *context, const World *world, int i, int j);
-static void Builder_BuildTileY(BuilderContext *context, const World *world, int i, int j);
-static void Builder_BuildTileZ(BuilderContext *context, const World *world, int i, int j);
-
-static void Builder_BuildTileWallDiagonal(BuilderContext *context, const World *world, int i, int j, const BuilderRule *builder_rule);
-static void Builder_BuildTileWallBlock(BuilderContext *context, const World *world, int i, int j, const BuilderRule *builder_rule);
-static void Builder_BuildTileWall(BuilderContext *context, const World *world, int i, int j);
-
-static void Builder_BuildTile(BuilderContext *context, const World *world, int i, int j);
-
-static void Builder_BuildPlaneDiagonal(BuilderContext *context, const Vec3 *position, const Vec3 *add, float texture);
-static void Builder_BuildPlane(BuilderContext *context, const Vec3 *position, const Vec3 *add, float texture);
-static void Builder_BuildPlaneX(BuilderContext *context, const Vec3 *position, float height, float texture);
-static void Builder_BuildPlaneY(BuilderContext *context, const Vec3 *position, float texture);
-static void Builder_BuildPlaneZ(BuilderContext *context, const Vec3 *position, float height, float texture);
-
-static const BuilderRule general_builder_rules[WALLTYPE_NUMTYPES] = {
-	[WALLTYPE_BLOCK] = { .buildwall = Builder_BuildTileWallBlock, .offset = {0.0f, 0.0f, 0.0f}, .size = {1.0f, 0.0f, 1.0f} },
-	[WALLTYPE_HALFBLOCK_DOWN] = { .buildwall = Builder_BuildTileWallBlock, .offset = {0.0f, 0.0f, 0.0f}, .size = {1.0f, 0.0f, 0.5f} },
-	[WALLTYPE_HALFBLOCK_UP] = { .buildwall = Builder_BuildTileWallBlock, .offset = {0.0f, 0.0f, 0.5f}, .size = {1.0f, 0.0f, 0.5f} },
-	[WALLTYPE_HALFBLOCK_LEFT] = { .buildwall = Builder_BuildTileWallBlock, .offset = {0.0f, 0.0f, 0.0f}, .size = {0.5f, 0.0f, 1.0f} },
-	[WALLTYPE_HALFBLOCK_RIGHT] = { .buildwall = Builder_BuildTileWallBlock, .offset = {0.5f, 0.0f, 0.0f}, .size = {0.5f, 0.0f, 1.0f} },
-	[WALLTYPE_HALFBLOCK_MIDDLE] = { .buildwall = Builder_BuildTileWallBlock, .offset = {0.25, 0.0f, 0.25f}, .size = {0.5f, 0.0f, 0.5f} },
-	[WALLTYPE_DIAGONAL_DOWNLEFT] = { .buildwall = Builder_BuildTileWallDiagonal, .diagonal_wall_flag = 0, .diagonal_down_to_top = true },
-	[WALLTYPE_DIAGONAL_DOWNRIGHT] = { .buildwall = Builder_BuildTileWallDiagonal, .diagonal_wall_flag = 1, .diagonal_down_to_top = false },
-	[WALLTYPE_DIAGONAL_UPLEFT] = { .buildwall = Builder_BuildTileWallDiagonal, .diagonal_wall_flag = 2, .diagonal_down_to_top = false },
-	[WALLTYPE_DIAGONAL_UPRIGHT] = { .buildwall = Builder_BuildTileWallDiagonal, .diagonal_wall_flag = 3, .diagonal_down_to_top = true },
+/* Degrau entre dois tiles vizinhos, da altura y até y + height */
+typedef struct {
+	bool present;
+	float y;
+	float height;
+	int texture;
+	bool lit;
+} BuilderStep;
+
+/* Bordas de um tile. A borda oposta é sempre edge ^ 1 */
+typedef enum {
+	BUILDER_EDGE_LEFT = 0,
+	BUILDER_EDGE_RIGHT,
+	BUILDER_EDGE_DOWN,
+	BUILDER_EDGE_UP
+} BuilderEdge;
+
+/* Cópia dos tiles de um chunk e de uma borda de BUILDER_APRON tiles ao
+ * redor dele, que é tudo que o builder lê. Os workers só usam a cópia,
+ * então o mundo pode ser editado enquanto eles trabalham.
+ *
+ * Os LODs usam a mesma estrutura com uma grade mais grossa: x, y e size
+ * são medidos em tiles da grade, e cada um vale scale tiles do mundo. A
+ * borda tem a largura de um bloco do LOD mais grosso, para que o tile
+ * grosso do outro lado da borda saia do mesmo bloco que o vizinho junta
+ * e os dois chunks concordem na emenda. */
+#define BUILDER_APRON ( 1 << (CHUNK_NUM_LODS - 1) )
+#define BUILDER_TILES_SIZE ( CHUNK_SIZE + 2 * BUILDER_APRON )
+
+/* World_EditTile e o cache só olham até CHUNK_BUILD_REACH */
+typedef char builder_apron_check[BUILDER_APRON <= CHUNK_BUILD_REACH ? 1 : -1];
+
+/* A grade de sombra cobre o chunk e o raio máximo de uma luz em volta,
+ * em tiles do mundo: o caminho de um vértice até uma luz que o alcança
+ * nunca sai dela */
+#define BUILDER_SHADOW_SIZE ( CHUNK_SIZE + 2 * CHUNK_BUILD_REACH )
+
+/* O teste de sombra começa esse tanto para fora da face e na direção da
+ * luz, para que um vértice na borda de uma parede não caia nela */
+#define BUILDER_SHADOW_OFFSET 0.01f
+
+/* Nos LODs as alturas são arredondadas para múltiplos disso vezes a
+ * escala, o que some com degraus pequenos */
+#define BUILDER_LOD_HEIGHT_STEP 0.125f
+
+struct BuilderTiles {
+	int chunk;
+	int revision;
+	int x, y;
+	int size;
+	int scale;
+
+	/* Tamanho do mundo na mesma grade */
+	int width, height;
+	Tile tiles[BUILDER_TILES_SIZE * BUILDER_TILES_SIZE];
+
+	/* Só as luzes que alcançam o chunk. Cabem todas as do mundo, as
+	 * mesmas que ChunkCache_HashChunk usa na chave */
+	Vec3 ambient_light;
+	WorldLight lights[WORLD_MAX_LIGHTS];
+	int num_lights;
+
+	/* Tiles que barram a luz, a partir do tile (shadow_x, shadow_y) do
+	 * mundo. Só é preenchida quando o chunk tem luzes. */
+	int shadow_x, shadow_y;
+	uint8_t blockers[BUILDER_SHADOW_SIZE * BUILDER_SHADOW_SIZE];
 };
 
-void Builder_BuildMesh(Memory *stack, World *world) {
-	for(int i = 0; i < NUM_CHUNKS; i++) {
-		for(int j = 0; j < NUM_CHUNKS; j++) {
-			int index = i + j * NUM_CHUNKS;
-			Builder_BuildChunk(&world->chunks[index].mesh, stack, world, i, j);
+typedef struct BuilderJobs BuilderJobs;
+
+/* Cada worker tem dois buffers de rascunho: enquanto um espera o upload
+ * na thread do contexto GL, o outro já recebe o próximo chunk. */
+typedef struct {
+	BuilderJobs *jobs;
+	Builder *builder;
+	SDL_Thread *thread;
+
+	Memory buffers[2];
+	int next_buffer;
+	SDL_sem *free_buffers;
+} BuilderWorker;
+
+typedef struct {
+	int chunk;
+	int revision;
+	bool built;
+	ChunkGeometry geometry[CHUNK_NUM_LODS];
+	BuilderWorker *worker;
+} BuilderResult;
+
+struct BuilderJobs {
+	const World *world;
+	const int *chunks;
+	int num_chunks;
+	SDL_atomic_t next_chunk;
+
+	SDL_mutex *lock;
+	SDL_sem *ready;
+	BuilderResult *results;
+	int num_results;
+};
+
+/* Refaz chunks em segundo plano enquanto o jogo roda. Os pedidos e os
+ * resultados são filas circulares protegidas por lock; cada worker tem no
+ * máximo dois resultados esperando upload, o que limita a fila. */
+struct Builder {
+	World *world;
+
+	BuilderWorker workers[BUILDER_MAX_BACKGROUND_WORKERS];
+	int num_workers;
+
+	SDL_mutex *lock;
+	SDL_sem *requests;
+	SDL_atomic_t quit;
+
+	/* Fila circular de cópias esperando um worker */
+	BuilderTiles *pending;
+	int queue_start, queue_count;
+
+	BuilderResult results[BUILDER_MAX_BACKGROUND_WORKERS * 2];
+	int results_start, results_count;
+};
+
+static void Builder_BuildChunks(Memory *stack, World *world, ChunkCache *cache, const int *chunks, int num_chunks);
+static void Builder_BuildChunksSerial(Memory *stack, World *world, ChunkCache *cache, const int *chunks, int num_chunks);
+static int Builder_WorkerMain(void *data);
+static int Builder_BackgroundMain(void *data);
+static void Builder_UploadChunk(World *world, ChunkCache *cache, int chunk, const ChunkGeometry *geometry, bool built);
+static void Builder_CopyTiles(BuilderTiles *tiles, const World *world, int chunk);
+static void Builder_CoarsenTiles(BuilderTiles *coarse, const BuilderTiles *tiles, int scale);
+static void Builder_MergeTiles(Tile *merged, const BuilderTiles *tiles, int i0, int j0, int i1, int j1, int scale);
+static const Tile * Builder_GetTile(const BuilderTiles *tiles, int i, int j);
+static bool Builder_BuildLods(ChunkGeometry *geometry, Memory *scratch, const BuilderTiles *tiles);
+static bool Builder_BuildTilesGeometry(ChunkGeometry *geometry, Memory *scratch, const BuilderTiles *tiles);
+static void Builder_BuildChunkPass(BuilderContext *context, const BuilderTiles *tiles, int x, int y);
+static PackedVertex *Builder_AllocVertices(BuilderContext *context, size_t num_vertices);
+
+static void Builder_BuildPlanesY(BuilderContext *context, const BuilderTiles *tiles, int x, int y, bool ceiling);
+static bool Builder_SamePlaneY(const Tile *a, const Tile *b, bool ceiling);
+static bool Builder_CanMergePlaneY(const BuilderTiles *tiles, const Tile *tile, int i, int j, bool ceiling);
+static void Builder_BuildSteps(BuilderContext *context, const BuilderTiles *tiles, int x, int y, bool along_z);
+static void Builder_GetStep(BuilderStep *step, const Tile *owner, const Tile *other, bool top);
+
+static void Builder_BuildTileWallDiagonal(BuilderContext *context, const BuilderTiles *tiles, int i, int j, const WallShape *shape);
+static void Builder_BuildTileWallBlock(BuilderContext *context, const BuilderTiles *tiles, int i, int j, const WallShape *shape);
+static void Builder_BuildTileWall(BuilderContext *context, const BuilderTiles *tiles, int i, int j);
+static bool Builder_GetCoverage(const Tile *tile, BuilderEdge edge, float *min, float *max);
+static bool Builder_IsFaceHidden(const BuilderTiles *tiles, int i, int j, BuilderEdge edge, float min, float max);
+
+static bool Builder_IsTileLit(const BuilderTiles *tiles, int i, int j);
+static bool Builder_BlocksLight(const PackedTile *packed);
+static bool Builder_IsLightBlocked(const BuilderTiles *tiles, float x, float z, const Vec3 *light);
+static bool Builder_IsPlaneYPlain(const BuilderTiles *tiles, int i, int j, bool ceiling);
+static float Builder_GetSolidity(const Tile *tile, float y);
+static float Builder_GetOcclusion(const BuilderTiles *tiles, const Vec3 *position, const Vec3 *normal);
+static void Builder_ShadeVertex(const BuilderContext *context, PackedVertex *vertex, const Vec3 *position, PackedNormal normal);
+
+static void Builder_ScalePlane(const BuilderContext *context, Vec3 *position, Vec3 *add, const Vec3 *grid_position, const Vec3 *grid_add);
+static float Builder_GetUvBase(float start, float length);
+static void Builder_BuildPlaneDiagonal(BuilderContext *context, const Vec3 *position, const Vec3 *add, float texture, PackedNormal normal);
+static void Builder_BuildPlane(BuilderContext *context, const Vec3 *position, const Vec3 *add, float texture, PackedNormal normal);
+static void Builder_BuildPlaneX(BuilderContext *context, const Vec3 *position, float height, float texture, PackedNormal normal);
+static void Builder_BuildPlaneZ(BuilderContext *context, const Vec3 *position, float height, float texture, PackedNormal normal);
+
+#define BUILDER_DIAGONAL 0.70710678f
+
+static const Vec3 builder_normals[PACKED_NORMAL_NUMNORMALS] = {
+	[PACKED_NORMAL_NONE] = { 0.0f, 0.0f, 0.0f },
+	[PACKED_NORMAL_POSITIVE_X] = { 1.0f, 0.0f, 0.0f },
+	[PACKED_NORMAL_NEGATIVE_X] = { -1.0f, 0.0f, 0.0f },
+	[PACKED_NORMAL_POSITIVE_Y] = { 0.0f, 1.0f, 0.0f },
+	[PACKED_NORMAL_NEGATIVE_Y] = { 0.0f, -1.0f, 0.0f },
+	[PACKED_NORMAL_POSITIVE_Z] = { 0.0f, 0.0f, 1.0f },
+	[PACKED_NORMAL_NEGATIVE_Z] = { 0.0f, 0.0f, -1.0f },
+	[PACKED_NORMAL_DIAGONAL_PP] = { BUILDER_DIAGONAL, 0.0f, BUILDER_DIAGONAL },
+	[PACKED_NORMAL_DIAGONAL_PN] = { BUILDER_DIAGONAL, 0.0f, -BUILDER_DIAGONAL },
+	[PACKED_NORMAL_DIAGONAL_NP] = { -BUILDER_DIAGONAL, 0.0f, BUILDER_DIAGONAL },
+	[PACKED_NORMAL_DIAGONAL_NN] = { -BUILDER_DIAGONAL, 0.0f, -BUILDER_DIAGONAL },
+};
+
+void Builder_BuildMesh(Memory *stack, World *world, const char *cache_filename) {
+	MemoryScope scope = Memory_BeginScope(stack);
+	int *chunks = Memory_AllocTagged(stack, (world->num_chunks + 1) * sizeof(int), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_BUILDER);
+	ChunkCache *cache = NULL;
+	ChunkGeometry geometry[CHUNK_NUM_LODS];
+	int num_chunks = 0;
+	int index;
+	bool found;
+
+	if(chunks == NULL) {
+		fprintf(stderr, "Not enough memory for the chunk list.\n");
+		Memory_EndScope(&scope);
+		return;
+	}
+
+	if(cache_filename != NULL) {
+		cache = Memory_AllocTagged(stack, sizeof(ChunkCache), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_BUILDER);
+
+		if(cache != NULL && !ChunkCache_Open(cache, stack, world, cache_filename))
+			cache = NULL;
+	}
+
+	/* Os chunks que estão no cache vão direto do mmap para a GPU */
+	for(int i = 0; i < world->num_chunks; i++) {
+		index = world->chunks[i]->index;
+		world->chunks[i]->dirty = false;
+
+		found = cache != NULL;
+
+		for(int lod = 0; lod < CHUNK_NUM_LODS && found; lod++)
+			found = ChunkCache_Find(cache, index, lod, &geometry[lod].vertices, &geometry[lod].num_vertices);
+
+		if(found)
+			Builder_UploadChunk(world, NULL, index, geometry, true);
+		else
+			chunks[num_chunks++] = index;
+	}
+
+	Builder_BuildChunks(stack, world, cache, chunks, num_chunks);
+
+	if(cache != NULL)
+		ChunkCache_Close(cache);
+
+	Memory_EndScope(&scope);
+}
+
+Builder * Builder_Create(Memory *memory, World *world) {
+	Builder *builder;
+	int max_workers;
+
+	builder = Memory_AllocTagged(memory, sizeof(Builder), MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+	if(builder == NULL)
+		return NULL;
+
+	builder->world = world;
+	builder->num_workers = 0;
+	SDL_AtomicSet(&builder->quit, 0);
+	builder->queue_start = 0;
+	builder->queue_count = 0;
+	builder->results_start = 0;
+	builder->results_count = 0;
+
+	builder->pending = Memory_AllocTagged(memory, BUILDER_MAX_PENDING * sizeof(BuilderTiles), MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+	builder->lock = SDL_CreateMutex();
+	builder->requests = SDL_CreateSemaphore(0);
+
+	if(builder->pending == NULL || builder->lock == NULL || builder->requests == NULL) {
+		Builder_Destroy(builder);
+		return NULL;
+	}
+
+	/* Um núcleo fica com o jogo; o resto não precisa de muitos workers,
+	 * já que edições costumam sujar poucos chunks por vez */
+	max_workers = SDL_GetCPUCount() - 1;
+
+	if(max_workers > BUILDER_MAX_BACKGROUND_WORKERS)
+		max_workers = BUILDER_MAX_BACKGROUND_WORKERS;
+
+	if(max_workers < 1)
+		max_workers = 1;
+
+	for(; builder->num_workers < max_workers; builder->num_workers++) {
+		BuilderWorker *worker = &builder->workers[builder->num_workers];
+		void *blocks[2];
+
+		blocks[0] = Memory_AllocTagged(memory, BUILDER_SCRATCH_MEMORY, MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+		blocks[1] = Memory_AllocTagged(memory, BUILDER_SCRATCH_MEMORY, MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+		if(blocks[0] == NULL || blocks[1] == NULL)
+			break;
+
+		worker->jobs = NULL;
+		worker->builder = builder;
+		worker->buffers[0] = Memory_Create(blocks[0], BUILDER_SCRATCH_MEMORY);
+		worker->buffers[1] = Memory_Create(blocks[1], BUILDER_SCRATCH_MEMORY);
+		worker->next_buffer = 0;
+		worker->free_buffers = SDL_CreateSemaphore(2);
+
+		if(worker->free_buffers == NULL)
+			break;
+
+		worker->thread = SDL_CreateThread(Builder_BackgroundMain, "builder", worker);
+
+		if(worker->thread == NULL) {
+			SDL_DestroySemaphore(worker->free_buffers);
+			break;
 		}
 	}
+
+	if(builder->num_workers == 0) {
+		fprintf(stderr, "Failed to start the builder threads.\n");
+		Builder_Destroy(builder);
+		return NULL;
+	}
+
+	return builder;
 }
 
-static void Builder_BuildChunk(Mesh *mesh, Memory *stack, const World *world, int x, int y) {
-	size_t used = stack->size / 4;
-	size_t old_state = Memory_SaveState(stack);
+void Builder_Destroy(Builder *builder) {
+	SDL_AtomicSet(&builder->quit, 1);
 
-	BuilderContext context = {
-		Memory_Alloc(stack, used),
-		0,
-		used / sizeof(Vertex),
-		Memory_Alloc(stack, used),
-		0,
-		used / sizeof(unsigned int)
-	};
+	/* Acorda os workers que esperam um pedido ou um buffer livre */
+	for(int i = 0; i < builder->num_workers; i++) {
+		SDL_SemPost(builder->requests);
+		SDL_SemPost(builder->workers[i].free_buffers);
+	}
 
-	for(int i = 0; i < CHUNK_SIZE; i++) {
-		for(int j = 0; j < CHUNK_SIZE; j++) {
-			Builder_BuildTile(
-					&context,
-					world,
-					x * CHUNK_SIZE + i,
-					y * CHUNK_SIZE + j
-					);
+	for(int i = 0; i < builder->num_workers; i++) {
+		SDL_WaitThread(builder->workers[i].thread, NULL);
+		SDL_DestroySemaphore(builder->workers[i].free_buffers);
+	}
+
+	builder->num_workers = 0;
+
+	if(builder->requests != NULL)
+		SDL_DestroySemaphore(builder->requests);
+
+	if(builder->lock != NULL)
+		SDL_DestroyMutex(builder->lock);
+
+	builder->requests = NULL;
+	builder->lock = NULL;
+}
+
+int Builder_QueueDirtyChunks(Builder *builder) {
+	World *world = builder->world;
+	BuilderTiles *tiles;
+	Chunk *chunk;
+	int num_chunks = 0;
+	int slot;
+
+	for(int i = 0; i < world->num_chunks; i++) {
+		chunk = world->chunks[i];
+
+		if(!chunk->dirty)
+			continue;
+
+		SDL_LockMutex(builder->lock);
+
+		/* Um chunk que já espera na fila só tem a cópia atualizada */
+		for(slot = 0; slot < builder->queue_count; slot++) {
+			if(builder->pending[(builder->queue_start + slot) % BUILDER_MAX_PENDING].chunk == chunk->index)
+				break;
+		}
+
+		if(slot == BUILDER_MAX_PENDING) {
+			SDL_UnlockMutex(builder->lock);
+			break;
+		}
+
+		tiles = &builder->pending[(builder->queue_start + slot) % BUILDER_MAX_PENDING];
+
+		/* Um resultado com revisão antiga é descartado no upload, então um
+		 * chunk que muda enquanto é construído acaba refeito */
+		chunk->dirty = false;
+		chunk->revision = ++world->last_revision;
+		Builder_CopyTiles(tiles, world, chunk->index);
+
+		if(slot == builder->queue_count) {
+			builder->queue_count++;
+			SDL_SemPost(builder->requests);
+		}
+
+		SDL_UnlockMutex(builder->lock);
+
+		num_chunks++;
+	}
+
+	return num_chunks;
+}
+
+int Builder_UploadReady(Builder *builder, float budget_ms) {
+	World *world = builder->world;
+	Uint64 start = SDL_GetPerformanceCounter();
+	Uint64 budget = (Uint64) (budget_ms * 0.001f * SDL_GetPerformanceFrequency());
+	BuilderResult result;
+	Chunk *chunk;
+	int num_uploads = 0;
+
+	/* Sempre sobe ao menos um chunk por quadro para a fila andar */
+	do {
+		SDL_LockMutex(builder->lock);
+
+		if(builder->results_count == 0) {
+			SDL_UnlockMutex(builder->lock);
+			break;
+		}
+
+		result = builder->results[builder->results_start];
+		builder->results_start = (builder->results_start + 1) % (BUILDER_MAX_BACKGROUND_WORKERS * 2);
+		builder->results_count--;
+
+		SDL_UnlockMutex(builder->lock);
+
+		chunk = World_GetChunk(world, result.chunk);
+
+		/* O chunk pode ter mudado ou sumido enquanto era construído */
+		if(chunk != NULL && result.revision == chunk->revision) {
+			Builder_UploadChunk(world, NULL, result.chunk, result.geometry, result.built);
+			num_uploads++;
+		}
+
+		SDL_SemPost(result.worker->free_buffers);
+	} while(SDL_GetPerformanceCounter() - start < budget);
+
+	return num_uploads;
+}
+
+static void Builder_BuildChunks(Memory *stack, World *world, ChunkCache *cache, const int *chunks, int num_chunks) {
+	BuilderWorker workers[BUILDER_MAX_WORKERS];
+	BuilderJobs jobs;
+	BuilderResult result;
+	MemoryScope scope;
+	int num_workers, max_workers;
+
+	/* A thread principal fica com os uploads */
+	max_workers = SDL_GetCPUCount() - 1;
+
+	if(max_workers > BUILDER_MAX_WORKERS)
+		max_workers = BUILDER_MAX_WORKERS;
+
+	if(max_workers > num_chunks)
+		max_workers = num_chunks;
+
+	if(max_workers < 2) {
+		Builder_BuildChunksSerial(stack, world, cache, chunks, num_chunks);
+		return;
+	}
+
+	scope = Memory_BeginScope(stack);
+
+	jobs.world = world;
+	jobs.chunks = chunks;
+	jobs.num_chunks = num_chunks;
+	SDL_AtomicSet(&jobs.next_chunk, 0);
+	jobs.num_results = 0;
+	jobs.results = Memory_AllocTagged(stack, num_chunks * sizeof(BuilderResult), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_BUILDER);
+	jobs.lock = SDL_CreateMutex();
+	jobs.ready = SDL_CreateSemaphore(0);
+
+	num_workers = 0;
+
+	if(jobs.results != NULL && jobs.lock != NULL && jobs.ready != NULL) {
+		for(; num_workers < max_workers; num_workers++) {
+			BuilderWorker *worker = &workers[num_workers];
+			void *blocks[2];
+
+			blocks[0] = Memory_AllocTagged(stack, BUILDER_SCRATCH_MEMORY, MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+			blocks[1] = Memory_AllocTagged(stack, BUILDER_SCRATCH_MEMORY, MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+			if(blocks[0] == NULL || blocks[1] == NULL)
+				break;
+
+			worker->jobs = &jobs;
+			worker->builder = NULL;
+			worker->buffers[0] = Memory_Create(blocks[0], BUILDER_SCRATCH_MEMORY);
+			worker->buffers[1] = Memory_Create(blocks[1], BUILDER_SCRATCH_MEMORY);
+			worker->next_buffer = 0;
+			worker->free_buffers = SDL_CreateSemaphore(2);
+
+			if(worker->free_buffers == NULL)
+				break;
+
+			worker->thread = SDL_CreateThread(Builder_WorkerMain, "builder", worker);
+
+			if(worker->thread == NULL) {
+				SDL_DestroySemaphore(worker->free_buffers);
+				break;
+			}
 		}
 	}
 
-	Mesh_Create(
-			mesh,
-			context.vertices,
-			context.vcount,
-			context.indices,
-			context.icount
-			);
+	/* Uploads só podem ser feitos na thread do contexto GL */
+	for(int i = 0; i < num_chunks && num_workers > 0; i++) {
+		SDL_SemWait(jobs.ready);
 
-	Memory_RestoreState(stack, old_state);
+		SDL_LockMutex(jobs.lock);
+		result = jobs.results[i];
+		SDL_UnlockMutex(jobs.lock);
+
+		Builder_UploadChunk(world, cache, result.chunk, result.geometry, result.built);
+
+		SDL_SemPost(result.worker->free_buffers);
+	}
+
+	for(int i = 0; i < num_workers; i++) {
+		SDL_WaitThread(workers[i].thread, NULL);
+		SDL_DestroySemaphore(workers[i].free_buffers);
+	}
+
+	if(jobs.lock != NULL)
+		SDL_DestroyMutex(jobs.lock);
+
+	if(jobs.ready != NULL)
+		SDL_DestroySemaphore(jobs.ready);
+
+	Memory_EndScope(&scope);
+
+	if(num_workers == 0)
+		Builder_BuildChunksSerial(stack, world, cache, chunks, num_chunks);
 }
 
-static void Builder_AllocVertices(BuilderContext *context, size_t num_vertices) {
-	if(context->vcount + num_vertices > context->max_vertices) {
-		fprintf(stderr, "Not enough memory for loading vertex data.");
-		exit(1);
+static void Builder_BuildChunksSerial(Memory *stack, World *world, ChunkCache *cache, const int *chunks, int num_chunks) {
+	ChunkGeometry geometry[CHUNK_NUM_LODS];
+	MemoryScope scope;
+	Memory scratch;
+	void *block;
+	bool built;
+
+	scope = Memory_BeginScope(stack);
+	block = Memory_AllocTagged(stack, BUILDER_SCRATCH_MEMORY, MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+	if(block == NULL) {
+		fprintf(stderr, "Not enough memory for building chunks.\n");
+		Memory_EndScope(&scope);
+		return;
 	}
 
-	context->vcount += num_vertices;
+	scratch = Memory_Create(block, BUILDER_SCRATCH_MEMORY);
+
+	for(int i = 0; i < num_chunks; i++) {
+		Memory_Free(&scratch);
+
+		built = Builder_BuildChunkGeometry(geometry, &scratch, world, chunks[i]);
+
+		Builder_UploadChunk(world, cache, chunks[i], geometry, built);
+	}
+
+	Memory_EndScope(&scope);
 }
 
-static void Builder_AllocIndices(BuilderContext *context, size_t num_indices) {
-	if(context->icount + num_indices > context->max_indices) {
-		fprintf(stderr, "Not enough memory for loading index data.");
-		exit(1);
+static int Builder_WorkerMain(void *data) {
+	BuilderWorker *worker = (BuilderWorker *) data;
+	BuilderJobs *jobs = worker->jobs;
+	BuilderResult result;
+	Memory *scratch;
+	int index;
+
+	while((index = SDL_AtomicAdd(&jobs->next_chunk, 1)) < jobs->num_chunks) {
+		/* Espera o upload que ainda usa o buffer mais antigo */
+		SDL_SemWait(worker->free_buffers);
+
+		scratch = &worker->buffers[worker->next_buffer];
+		worker->next_buffer ^= 1;
+		Memory_Free(scratch);
+
+		result.chunk = jobs->chunks[index];
+		result.worker = worker;
+		result.built = Builder_BuildChunkGeometry(result.geometry, scratch, jobs->world, result.chunk);
+
+		SDL_LockMutex(jobs->lock);
+		jobs->results[jobs->num_results++] = result;
+		SDL_UnlockMutex(jobs->lock);
+
+		SDL_SemPost(jobs->ready);
+	}
+
+	return 0;
+}
+
+static int Builder_BackgroundMain(void *data) {
+	BuilderWorker *worker = (BuilderWorker *) data;
+	Builder *builder = worker->builder;
+	BuilderTiles *tiles;
+	BuilderResult result;
+	Memory *scratch;
+
+	while(true) {
+		SDL_SemWait(builder->requests);
+
+		if(SDL_AtomicGet(&builder->quit))
+			break;
+
+		SDL_SemWait(worker->free_buffers);
+
+		if(SDL_AtomicGet(&builder->quit))
+			break;
+
+		scratch = &worker->buffers[worker->next_buffer];
+		worker->next_buffer ^= 1;
+		Memory_Free(scratch);
+
+		tiles = Memory_AllocTagged(scratch, sizeof(BuilderTiles), MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+		SDL_LockMutex(builder->lock);
+
+		result.chunk = builder->pending[builder->queue_start].chunk;
+		result.revision = builder->pending[builder->queue_start].revision;
+
+		if(tiles != NULL)
+			*tiles = builder->pending[builder->queue_start];
+
+		builder->queue_start = (builder->queue_start + 1) % BUILDER_MAX_PENDING;
+		builder->queue_count--;
+
+		SDL_UnlockMutex(builder->lock);
+
+		result.worker = worker;
+		result.built = tiles != NULL && Builder_BuildLods(result.geometry, scratch, tiles);
+
+		SDL_LockMutex(builder->lock);
+		builder->results[(builder->results_start + builder->results_count) % (BUILDER_MAX_BACKGROUND_WORKERS * 2)] = result;
+		builder->results_count++;
+		SDL_UnlockMutex(builder->lock);
 	}
 
-	context->icount += num_indices;
+	return 0;
 }
 
-static void Builder_BuildTileX(BuilderContext *context, const World *world, int i, int j) {
-	const Tile *tile = World_GetTile(world, i, j);
-	const Tile *left = World_GetTile(world, i - 1, j);
-	const Tile *right = World_GetTile(world, i + 1, j);
-	Vec3 position = {i, tile->bot_height, j};
+static void Builder_UploadChunk(World *world, ChunkCache *cache, int chunk, const ChunkGeometry *geometry, bool built) {
+	Chunk *target = World_GetChunk(world, chunk);
 
-	float bot_diff = 0.0f, top_diff = 0.0f;
+	/* Se falhar, o chunk continua com as meshes antigas */
+	if(target == NULL)
+		return;
 
-	if(left != NULL) {
-		bot_diff = left->bot_height - tile->bot_height;
-		top_diff = left->top_height - tile->top_height;
+	if(!built) {
+		fprintf(stderr, "Failed to build chunk %d.\n", chunk);
+		return;
 	}
 
-	if(bot_diff < 0.0f) {
-		Builder_BuildPlaneX(context, &position, bot_diff, tile->bot_window_texture);
+	for(int lod = 0; lod < CHUNK_NUM_LODS; lod++) {
+		if(!Mesh_UpdatePacked(&target->lods[lod], geometry[lod].vertices, geometry[lod].num_vertices))
+			continue;
+
+		if(cache != NULL)
+			ChunkCache_Store(cache, chunk, lod, geometry[lod].vertices, geometry[lod].num_vertices);
 	}
+}
 
-	if(top_diff > 0.0f) {
-		position.y = tile->top_height;
-		Builder_BuildPlaneX(context, &position, top_diff, tile->top_window_texture);
+static void Builder_CopyTiles(BuilderTiles *tiles, const World *world, int chunk) {
+	const Chunk *source = World_GetChunk(world, chunk);
+	const PackedTile *packed;
+
+	tiles->chunk = chunk;
+	tiles->revision = source->revision;
+	tiles->x = source->x;
+	tiles->y = source->y;
+	tiles->size = CHUNK_SIZE;
+	tiles->scale = 1;
+	tiles->width = world->width;
+	tiles->height = world->height;
+
+	/* O primeiro anel vem da borda copiada dos vizinhos; o resto, só
+	 * usado pelos LODs, é lido direto do mundo */
+	for(int j = -BUILDER_APRON; j < CHUNK_SIZE + BUILDER_APRON; j++) {
+		for(int i = -BUILDER_APRON; i < CHUNK_SIZE + BUILDER_APRON; i++) {
+			if(i >= -1 && j >= -1 && i <= CHUNK_SIZE && j <= CHUNK_SIZE)
+				packed = Chunk_GetTile(source, i, j);
+			else
+				packed = World_GetPackedTile(world, source->x + i, source->y + j);
+
+			World_UnpackTile(&tiles->tiles[(i + BUILDER_APRON) + (j + BUILDER_APRON) * BUILDER_TILES_SIZE], packed);
+		}
 	}
 
-	position = (Vec3) {i + 1, tile->bot_height, j};
+	tiles->ambient_light = world->ambient_light;
+	tiles->num_lights = 0;
 
-	if(right != NULL) {
-		bot_diff = right->bot_height - tile->bot_height;
-		top_diff = right->top_height - tile->top_height;
+	for(int i = 0; i < world->num_lights; i++) {
+		if(World_LightReachesChunk(&world->lights[i], source))
+			tiles->lights[tiles->num_lights++] = world->lights[i];
 	}
 
-	if(bot_diff < 0.0f) {
-		Builder_BuildPlaneX(context, &position, bot_diff, tile->bot_window_texture);
+	tiles->shadow_x = source->x - CHUNK_BUILD_REACH;
+	tiles->shadow_y = source->y - CHUNK_BUILD_REACH;
+
+	if(tiles->num_lights == 0)
+		return;
+
+	for(int j = -CHUNK_BUILD_REACH; j < CHUNK_SIZE + CHUNK_BUILD_REACH; j++) {
+		for(int i = -CHUNK_BUILD_REACH; i < CHUNK_SIZE + CHUNK_BUILD_REACH; i++) {
+			if(i >= -1 && j >= -1 && i <= CHUNK_SIZE && j <= CHUNK_SIZE)
+				packed = Chunk_GetTile(source, i, j);
+			else
+				packed = World_GetPackedTile(world, source->x + i, source->y + j);
+
+			tiles->blockers[(i + CHUNK_BUILD_REACH) + (j + CHUNK_BUILD_REACH) * BUILDER_SHADOW_SIZE] = Builder_BlocksLight(packed);
+		}
 	}
+}
 
-	if(top_diff > 0.0f) {
-		position.y = tile->top_height;
-		Builder_BuildPlaneX(context, &position, top_diff, tile->top_window_texture);
+static void Builder_CoarsenTiles(BuilderTiles *coarse, const BuilderTiles *tiles, int scale) {
+	int i0, i1, j0, j1;
+
+	coarse->chunk = tiles->chunk;
+	coarse->revision = tiles->revision;
+	coarse->width = tiles->width / scale;
+	coarse->height = tiles->height / scale;
+	coarse->x = tiles->x / scale;
+	coarse->y = tiles->y / scale;
+	coarse->size = tiles->size / scale;
+	coarse->scale = scale;
+
+	coarse->ambient_light = tiles->ambient_light;
+	coarse->num_lights = tiles->num_lights;
+
+	for(int i = 0; i < tiles->num_lights; i++)
+		coarse->lights[i] = tiles->lights[i];
+
+	/* A sombra continua em tiles do mundo, igual à do LOD 0 */
+	coarse->shadow_x = tiles->shadow_x;
+	coarse->shadow_y = tiles->shadow_y;
+
+	if(tiles->num_lights > 0)
+		memcpy(coarse->blockers, tiles->blockers, sizeof(coarse->blockers));
+
+	/* A borda da grade grossa junta o bloco inteiro do vizinho, igual
+	 * ao que ele junta para o próprio tile */
+	for(int j = -1; j <= coarse->size; j++) {
+		for(int i = -1; i <= coarse->size; i++) {
+			i0 = i * scale;
+			j0 = j * scale;
+			i1 = i0 + scale;
+			j1 = j0 + scale;
+
+			Builder_MergeTiles(
+					&coarse->tiles[(i + BUILDER_APRON) + (j + BUILDER_APRON) * BUILDER_TILES_SIZE],
+					tiles,
+					tiles->x + i0,
+					tiles->y + j0,
+					tiles->x + i1,
+					tiles->y + j1,
+					scale
+					);
+		}
 	}
 }
 
-static void Builder_BuildTileY(BuilderContext *context, const World *world, int i, int j) {
-	const Tile *tile = World_GetTile(world, i, j);
-	Vec3 position = {i, tile->bot_height, j};
+static void Builder_MergeTiles(Tile *merged, const BuilderTiles *tiles, int i0, int j0, int i1, int j1, int scale) {
+	const Tile *tile, *first_open = NULL, *first_wall = NULL;
+	float step = BUILDER_LOD_HEIGHT_STEP * scale;
+	float bot = 0.0f, top = 0.0f;
+	int num_tiles = 0, num_walls = 0;
+
+	for(int j = j0; j < j1; j++) {
+		for(int i = i0; i < i1; i++) {
+			tile = Builder_GetTile(tiles, i, j);
+
+			if(tile == NULL)
+				continue;
 
-	if(tile->bot_height == tile->top_height)
+			num_tiles++;
+
+			if(tile->wall_type != WALLTYPE_NONE) {
+				num_walls++;
+
+				if(first_wall == NULL)
+					first_wall = tile;
+
+				continue;
+			}
+
+			/* Fica o chão mais alto e o teto mais baixo do bloco */
+			if(first_open == NULL) {
+				first_open = tile;
+				bot = tile->bot_height;
+				top = tile->top_height;
+			}
+
+			bot = fmaxf(bot, tile->bot_height);
+			top = fminf(top, tile->top_height);
+		}
+	}
+
+	if(num_tiles == 0)
 		return;
 
-	Builder_BuildPlaneY(context, &position, tile->bot_texture);
-	position.y = tile->top_height;
-	Builder_BuildPlaneY(context, &position, tile->top_texture);
+	if(first_open == NULL) {
+		first_open = first_wall;
+		bot = first_wall->bot_height;
+		top = first_wall->top_height;
+	}
+
+	*merged = *first_open;
+	merged->wall_type = num_walls * 2 >= num_tiles ? WALLTYPE_BLOCK : WALLTYPE_NONE;
+
+	if(first_wall != NULL)
+		merged->wall_texture = first_wall->wall_texture;
+
+	merged->bot_height = roundf(bot / step) * step;
+	merged->top_height = fmaxf(roundf(top / step) * step, merged->bot_height);
+}
+
+static const Tile * Builder_GetTile(const BuilderTiles *tiles, int i, int j) {
+	if(i < 0 || j < 0 || i >= tiles->width || j >= tiles->height)
+		return NULL;
+
+	i -= tiles->x - BUILDER_APRON;
+	j -= tiles->y - BUILDER_APRON;
+
+	return &tiles->tiles[i + j * BUILDER_TILES_SIZE];
+}
+
+bool Builder_BuildChunkGeometry(ChunkGeometry *geometry, Memory *scratch, const World *world, int chunk) {
+	BuilderTiles *tiles;
+
+	if(World_GetChunk(world, chunk) == NULL)
+		return false;
+
+	tiles = Memory_AllocTagged(scratch, sizeof(BuilderTiles), MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+	if(tiles == NULL)
+		return false;
+
+	Builder_CopyTiles(tiles, world, chunk);
+
+	return Builder_BuildLods(geometry, scratch, tiles);
 }
 
-static void Builder_BuildTileZ(BuilderContext *context, const World *world, int i, int j) {
-	const Tile *tile = World_GetTile(world, i, j);
-	const Tile *left = World_GetTile(world, i, j - 1);
-	const Tile *right = World_GetTile(world, i, j + 1);
-	Vec3 position = {i, tile->bot_height, j};
+static bool Builder_BuildLods(ChunkGeometry *geometry, Memory *scratch, const BuilderTiles *tiles) {
+	BuilderTiles *coarse;
 
-	float bot_diff = 0.0f, top_diff = 0.0f;
+	if(!Builder_BuildTilesGeometry(&geometry[0], scratch, tiles))
+		return false;
 
-	if(left != NULL) {
-		bot_diff = left->bot_height - tile->bot_height;
-		top_diff = left->top_height - tile->top_height;
+	if(CHUNK_NUM_LODS == 1)
+		return true;
+
+	coarse = Memory_AllocTagged(scratch, sizeof(BuilderTiles), MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+
+	if(coarse == NULL)
+		return false;
+
+	/* Todo LOD sai dos tiles originais, para os erros não se acumularem */
+	for(int lod = 1; lod < CHUNK_NUM_LODS; lod++) {
+		Builder_CoarsenTiles(coarse, tiles, 1 << lod);
+
+		if(!Builder_BuildTilesGeometry(&geometry[lod], scratch, coarse))
+			return false;
 	}
 
-	if(bot_diff < 0.0f) {
-		Builder_BuildPlaneZ(context, &position, bot_diff, tile->bot_window_texture);
+	return true;
+}
+
+static bool Builder_BuildTilesGeometry(ChunkGeometry *geometry, Memory *scratch, const BuilderTiles *tiles) {
+	BuilderContext context = {
+		NULL,
+		0,
+		0,
+		tiles->x * tiles->scale,
+		tiles->y * tiles->scale,
+		tiles->scale,
+		tiles
+	};
+	size_t num_vertices;
+
+	Builder_BuildChunkPass(&context, tiles, tiles->x, tiles->y);
+
+	num_vertices = context.vcount;
+
+	geometry->vertices = NULL;
+	geometry->num_vertices = 0;
+
+	if(num_vertices == 0)
+		return true;
+
+	context.vertices = Memory_AllocTagged(scratch, num_vertices * sizeof(PackedVertex), MEMORY_CACHE_LINE, MEMTAG_BUILDER);
+	context.vcount = 0;
+	context.max_vertices = num_vertices;
+
+	if(context.vertices == NULL) {
+		fprintf(stderr, "Chunk %d needs %zu vertices, over the builder budget.\n", tiles->chunk, num_vertices);
+		return false;
 	}
 
-	if(top_diff > 0.0f) {
-		position.y = tile->top_height;
-		Builder_BuildPlaneZ(context, &position, top_diff, tile->top_window_texture);
+	Builder_BuildChunkPass(&context, tiles, tiles->x, tiles->y);
+
+	if(context.vcount != num_vertices)
+		return false;
+
+	geometry->vertices = context.vertices;
+	geometry->num_vertices = num_vertices;
+
+	return true;
+}
+
+static void Builder_BuildChunkPass(BuilderContext *context, const BuilderTiles *tiles, int x, int y) {
+	Builder_BuildPlanesY(context, tiles, x, y, false);
+	Builder_BuildPlanesY(context, tiles, x, y, true);
+	Builder_BuildSteps(context, tiles, x, y, false);
+	Builder_BuildSteps(context, tiles, x, y, true);
+
+	for(int i = 0; i < tiles->size; i++) {
+		for(int j = 0; j < tiles->size; j++)
+			Builder_BuildTileWall(context, tiles, x + i, y + j);
 	}
+}
+
+static PackedVertex *Builder_AllocVertices(BuilderContext *context, size_t num_vertices) {
+	PackedVertex *vertices = NULL;
+
+	if(context->vertices != NULL && context->vcount + num_vertices <= context->max_vertices)
+		vertices = &context->vertices[context->vcount];
+
+	context->vcount += num_vertices;
+
+	return vertices;
+}
+
+static void Builder_BuildPlanesY(BuilderContext *context, const BuilderTiles *tiles, int x, int y, bool ceiling) {
+	bool done[CHUNK_SIZE * CHUNK_SIZE] = {false};
+	int size = tiles->size;
+	const Tile *tile;
+	int width, depth;
+	bool plain;
+	Vec3 position, add;
+
+	/* Junta tiles vizinhos com a mesma altura e textura em um único
+	 * retângulo, crescendo primeiro em x e depois em z */
+	for(int j = 0; j < size; j++) {
+		for(int i = 0; i < size; i++) {
+			if(done[i + j * size])
+				continue;
+
+			tile = Builder_GetTile(tiles, x + i, y + j);
 
-	position = (Vec3) {i, tile->bot_height, j + 1};
+			if(tile->bot_height == tile->top_height)
+				continue;
 
-	if(right != NULL) {
-		bot_diff = right->bot_height - tile->bot_height;
-		top_diff = right->top_height - tile->top_height;
+			width = 1;
+
+			/* Tiles com luz ou oclusão ficam sozinhos, senão a cor seria
+			 * interpolada entre cantos distantes do retângulo */
+			plain = Builder_IsPlaneYPlain(tiles, x + i, y + j, ceiling);
+
+			while(plain && i + width < size && !done[i + width + j * size]
+					&& Builder_CanMergePlaneY(tiles, tile, x + i + width, y + j, ceiling))
+				width++;
+
+			for(depth = 1; plain && j + depth < size; depth++) {
+				int k;
+
+				for(k = 0; k < width; k++) {
+					if(done[i + k + (j + depth) * size])
+						break;
+
+					if(!Builder_CanMergePlaneY(tiles, tile, x + i + k, y + j + depth, ceiling))
+						break;
+				}
+
+				if(k < width)
+					break;
+			}
+
+			for(int l = 0; l < depth; l++) {
+				for(int k = 0; k < width; k++)
+					done[i + k + (j + l) * size] = true;
+			}
+
+			position = (Vec3) {x + i, ceiling ? tile->top_height : tile->bot_height, y + j};
+			add = (Vec3) {width, 0.0f, depth};
+
+			Builder_BuildPlane(
+					context,
+					&position,
+					&add,
+					ceiling ? tile->top_texture : tile->bot_texture,
+					ceiling ? PACKED_NORMAL_NEGATIVE_Y : PACKED_NORMAL_POSITIVE_Y
+					);
+		}
 	}
+}
+
+static bool Builder_SamePlaneY(const Tile *a, const Tile *b, bool ceiling) {
+	if(b->bot_height == b->top_height)
+		return false;
+
+	if(ceiling)
+		return a->top_height == b->top_height && a->top_texture == b->top_texture;
 
-	if(bot_diff < 0.0f) {
-		Builder_BuildPlaneZ(context, &position, bot_diff, tile->bot_window_texture);
+	return a->bot_height == b->bot_height && a->bot_texture == b->bot_texture;
+}
+
+static bool Builder_CanMergePlaneY(const BuilderTiles *tiles, const Tile *tile, int i, int j, bool ceiling) {
+	return Builder_SamePlaneY(tile, Builder_GetTile(tiles, i, j), ceiling) && Builder_IsPlaneYPlain(tiles, i, j, ceiling);
+}
+
+static void Builder_BuildSteps(BuilderContext *context, const BuilderTiles *tiles, int x, int y, bool along_z) {
+	const Tile *before, *after, *owner, *other;
+	BuilderStep run;
+	int run_start;
+	int size = tiles->size;
+	int owner_i, owner_j;
+	PackedNormal normal;
+	Vec3 position, add;
+
+	/* Percorre cada linha entre dois tiles. Cada degrau pertence ao tile
+	 * mais alto, então só são gerados os que pertencem a tiles deste chunk */
+	for(int line = 0; line <= size; line++) {
+		for(int kind = 0; kind < 4; kind++) {
+			bool owner_before = kind & 1;
+			bool top = kind & 2;
+
+			if(owner_before && line == 0)
+				continue;
+
+			if(!owner_before && line == size)
+				continue;
+
+			/* A face aponta para o tile mais baixo */
+			if(along_z)
+				normal = owner_before ? PACKED_NORMAL_POSITIVE_Z : PACKED_NORMAL_NEGATIVE_Z;
+			else
+				normal = owner_before ? PACKED_NORMAL_POSITIVE_X : PACKED_NORMAL_NEGATIVE_X;
+
+			run = (BuilderStep) {false, 0.0f, 0.0f, 0, false};
+			run_start = 0;
+
+			for(int k = 0; k <= size; k++) {
+				/* Inteiro a cada tile: run = step copia todos os campos */
+				BuilderStep step = {false, 0.0f, 0.0f, 0, false};
+
+				if(k < size) {
+					if(along_z) {
+						before = Builder_GetTile(tiles, x + k, y + line - 1);
+						after = Builder_GetTile(tiles, x + k, y + line);
+					}
+					else {
+						before = Builder_GetTile(tiles, x + line - 1, y + k);
+						after = Builder_GetTile(tiles, x + line, y + k);
+					}
+
+					owner = owner_before ? before : after;
+					other = owner_before ? after : before;
+
+					if(owner != NULL && other != NULL)
+						Builder_GetStep(&step, owner, other, top);
+
+					if(step.present) {
+						owner_i = along_z ? x + k : x + line - owner_before;
+						owner_j = along_z ? y + line - owner_before : y + k;
+						step.lit = Builder_IsTileLit(tiles, owner_i, owner_j);
+					}
+				}
+
+				if(run.present && step.present && run.y == step.y && run.height == step.height && run.texture == step.texture && !run.lit && !step.lit)
+					continue;
+
+				if(run.present) {
+					if(along_z) {
+						position = (Vec3) {x + run_start, run.y, y + line};
+						add = (Vec3) {k - run_start, run.height, 0.0f};
+					}
+					else {
+						position = (Vec3) {x + line, run.y, y + run_start};
+						add = (Vec3) {0.0f, run.height, k - run_start};
+					}
+
+					Builder_BuildPlane(context, &position, &add, run.texture, normal);
+				}
+
+				run = step;
+				run_start = k;
+			}
+		}
 	}
+}
 
-	if(top_diff > 0.0f) {
-		position.y = tile->top_height;
-		Builder_BuildPlaneZ(context, &position, top_diff, tile->top_window_texture);
+static void Builder_GetStep(BuilderStep *step, const Tile *owner, const Tile *other, bool top) {
+	float diff;
+
+	if(top) {
+		diff = other->top_height - owner->top_height;
+		step->present = diff > 0.0f;
+		step->y = owner->top_height;
+		step->texture = owner->top_window_texture;
+	}
+	else {
+		diff = other->bot_height - owner->bot_height;
+		step->present = diff < 0.0f;
+		step->y = owner->bot_height;
+		step->texture = owner->bot_window_texture;
 	}
+
+	step->height = diff;
 }
 
-static void Builder_BuildTileWallDiagonal(BuilderContext *context, const World *world, int i, int j, const BuilderRule *builder_rule) {
-	const Tile *tile = World_GetTile(world, i, j);
+static void Builder_BuildTileWallDiagonal(BuilderContext *context, const BuilderTiles *tiles, int i, int j, const WallShape *shape) {
+	const Tile *tile = Builder_GetTile(tiles, i, j);
 	Vec3 position, add;
 	float add_x, add_z, height;
+	PackedNormal normal;
 
-	add_x = builder_rule->diagonal_wall_flag & 1 ? 1.0f : 0.0f;
-	add_z = builder_rule->diagonal_wall_flag & 2 ? 1.0f : 0.0f;
+	add_x = shape->corner & 1 ? 1.0f : 0.0f;
+	add_z = shape->corner & 2 ? 1.0f : 0.0f;
 	height = tile->top_height - tile->bot_height;
 
-	position = (Vec3) { i + add_x, tile->bot_height, j };
-	Builder_BuildPlaneX(context, &position, height, tile->wall_texture);
+	if(!Builder_IsFaceHidden(tiles, i, j, add_x ? BUILDER_EDGE_RIGHT : BUILDER_EDGE_LEFT, 0.0f, 1.0f)) {
+		position = (Vec3) { i + add_x, tile->bot_height, j };
+		Builder_BuildPlaneX(context, &position, height, tile->wall_texture, add_x ? PACKED_NORMAL_POSITIVE_X : PACKED_NORMAL_NEGATIVE_X);
+	}
 
-	position = (Vec3) { i, tile->bot_height, j + add_z };
-	Builder_BuildPlaneZ(context, &position, height, tile->wall_texture);
+	if(!Builder_IsFaceHidden(tiles, i, j, add_z ? BUILDER_EDGE_UP : BUILDER_EDGE_DOWN, 0.0f, 1.0f)) {
+		position = (Vec3) { i, tile->bot_height, j + add_z };
+		Builder_BuildPlaneZ(context, &position, height, tile->wall_texture, add_z ? PACKED_NORMAL_POSITIVE_Z : PACKED_NORMAL_NEGATIVE_Z);
+	}
 
-	if(builder_rule->diagonal_down_to_top) {
+	if(shape->down_to_top) {
 		position = (Vec3) { i + 1.0f, tile->bot_height, j };
 		add = (Vec3) { -1.0f, height, 1.0f };
 	}
@@ -230,107 +1145,405 @@ static void Builder_BuildTileWallDiagonal(BuilderContext *context, const World *
 		position = (Vec3) { i, tile->bot_height, j };
 		add = (Vec3) { 1.0f, height, 1.0f };
 	}
-	Builder_BuildPlaneDiagonal(context, &position, &add, tile->wall_texture);
+
+	/* A face diagonal aponta para longe do canto ocupado pela parede */
+	if(add_x)
+		normal = add_z ? PACKED_NORMAL_DIAGONAL_NN : PACKED_NORMAL_DIAGONAL_NP;
+	else
+		normal = add_z ? PACKED_NORMAL_DIAGONAL_PN : PACKED_NORMAL_DIAGONAL_PP;
+
+	Builder_BuildPlaneDiagonal(context, &position, &add, tile->wall_texture, normal);
 }
 
-static void Builder_BuildTileWallBlock(BuilderContext *context, const World *world, int i, int j, const BuilderRule *builder_rule) {
-	const Vec3 *offset, *size;
-	const Tile *tile = World_GetTile(world, i, j);
+static void Builder_BuildTileWallBlock(BuilderContext *context, const BuilderTiles *tiles, int i, int j, const WallShape *shape) {
+	const Tile *tile = Builder_GetTile(tiles, i, j);
 	float wall_diff;
 	Vec3 position, add;
 	float start_x, start_z;
 
-	offset = &builder_rule->offset;
-	size = &builder_rule->size;
-
-	start_x = (float) i + offset->x;
-	start_z = (float) j + offset->z;
+	start_x = (float) i + shape->offset_x;
+	start_z = (float) j + shape->offset_z;
 
 	wall_diff = tile->top_height - tile->bot_height;
 
-	position = (Vec3) {start_x, tile->bot_height, start_z};
-	add = (Vec3) {0.0f, wall_diff, size->z};
-	Builder_BuildPlane(context, &position, &add, tile->wall_texture);
+	/* Faces internas ao tile nunca são cobertas pelo vizinho */
+	if(shape->offset_x != 0.0f || !Builder_IsFaceHidden(tiles, i, j, BUILDER_EDGE_LEFT, shape->offset_z, shape->offset_z + shape->size_z)) {
+		position = (Vec3) {start_x, tile->bot_height, start_z};
+		add = (Vec3) {0.0f, wall_diff, shape->size_z};
+		Builder_BuildPlane(context, &position, &add, tile->wall_texture, PACKED_NORMAL_NEGATIVE_X);
+	}
 
-	add = (Vec3) {size->x, wall_diff, 0.0f};
-	Builder_BuildPlane(context, &position, &add, tile->wall_texture);
+	if(shape->offset_z != 0.0f || !Builder_IsFaceHidden(tiles, i, j, BUILDER_EDGE_DOWN, shape->offset_x, shape->offset_x + shape->size_x)) {
+		position = (Vec3) {start_x, tile->bot_height, start_z};
+		add = (Vec3) {shape->size_x, wall_diff, 0.0f};
+		Builder_BuildPlane(context, &position, &add, tile->wall_texture, PACKED_NORMAL_NEGATIVE_Z);
+	}
 
-	position = (Vec3) {start_x + size->x, tile->bot_height, start_z};
-	add = (Vec3) {0.0f, wall_diff, size->z};
-	Builder_BuildPlane(context, &position, &add, tile->wall_texture);
+	if(shape->offset_x + shape->size_x != 1.0f || !Builder_IsFaceHidden(tiles, i, j, BUILDER_EDGE_RIGHT, shape->offset_z, shape->offset_z + shape->size_z)) {
+		position = (Vec3) {start_x + shape->size_x, tile->bot_height, start_z};
+		add = (Vec3) {0.0f, wall_diff, shape->size_z};
+		Builder_BuildPlane(context, &position, &add, tile->wall_texture, PACKED_NORMAL_POSITIVE_X);
+	}
 
-	position = (Vec3) {start_x, tile->bot_height, start_z + size->z};
-	add = (Vec3) {size->x, wall_diff, 0.0f};
-	Builder_BuildPlane(context, &position, &add, tile->wall_texture);
+	if(shape->offset_z + shape->size_z != 1.0f || !Builder_IsFaceHidden(tiles, i, j, BUILDER_EDGE_UP, shape->offset_x, shape->offset_x + shape->size_x)) {
+		position = (Vec3) {start_x, tile->bot_height, start_z + shape->size_z};
+		add = (Vec3) {shape->size_x, wall_diff, 0.0f};
+		Builder_BuildPlane(context, &position, &add, tile->wall_texture, PACKED_NORMAL_POSITIVE_Z);
+	}
 }
 
-static void Builder_BuildTileWall(BuilderContext *context, const World *world, int i, int j) {
-	const Tile *tile = World_GetTile(world, i, j);
-	const BuilderRule *builder_rule;
+static void Builder_BuildTileWall(BuilderContext *context, const BuilderTiles *tiles, int i, int j) {
+	const Tile *tile = Builder_GetTile(tiles, i, j);
+	const WallShape *shape = WallShape_Get(tile->wall_type);
 
-	if(tile->wall_type == WALLTYPE_NONE)
+	if(shape->kind == WALLSHAPE_EMPTY || tile->top_height <= tile->bot_height)
 		return;
 
-	builder_rule = &general_builder_rules[tile->wall_type];
+	if(shape->kind == WALLSHAPE_DIAGONAL)
+		Builder_BuildTileWallDiagonal(context, tiles, i, j, shape);
+	else
+		Builder_BuildTileWallBlock(context, tiles, i, j, shape);
+}
+
+static bool Builder_GetCoverage(const Tile *tile, BuilderEdge edge, float *min, float *max) {
+	const WallShape *shape = WallShape_Get(tile->wall_type);
+
+	*min = 0.0f;
+	*max = 1.0f;
+
+	/* Chão e teto se encontram: a coluna inteira é sólida */
+	if(tile->top_height <= tile->bot_height)
+		return true;
+
+	if(shape->kind == WALLSHAPE_EMPTY)
+		return false;
+
+	if(shape->kind == WALLSHAPE_DIAGONAL) {
+		if(edge == BUILDER_EDGE_LEFT || edge == BUILDER_EDGE_RIGHT)
+			return (edge == BUILDER_EDGE_RIGHT) == ((shape->corner & 1) != 0);
+
+		return (edge == BUILDER_EDGE_UP) == ((shape->corner & 2) != 0);
+	}
+
+	switch(edge) {
+		case BUILDER_EDGE_LEFT:
+		case BUILDER_EDGE_RIGHT:
+			*min = shape->offset_z;
+			*max = shape->offset_z + shape->size_z;
 
-	builder_rule->buildwall(context, world, i, j, builder_rule);
+			if(edge == BUILDER_EDGE_LEFT)
+				return shape->offset_x == 0.0f;
+
+			return shape->offset_x + shape->size_x == 1.0f;
+
+		case BUILDER_EDGE_DOWN:
+		case BUILDER_EDGE_UP:
+			*min = shape->offset_x;
+			*max = shape->offset_x + shape->size_x;
+
+			if(edge == BUILDER_EDGE_DOWN)
+				return shape->offset_z == 0.0f;
+
+			return shape->offset_z + shape->size_z == 1.0f;
+	}
+
+	return false;
+}
+
+static bool Builder_IsFaceHidden(const BuilderTiles *tiles, int i, int j, BuilderEdge edge, float min, float max) {
+	static const int step_x[4] = { -1, 1, 0, 0 };
+	static const int step_z[4] = { 0, 0, -1, 1 };
+	const Tile *neighbour;
+	float covered_min, covered_max;
+
+	neighbour = Builder_GetTile(tiles, i + step_x[edge], j + step_z[edge]);
+
+	/* Fora do mundo tudo é sólido */
+	if(neighbour == NULL)
+		return true;
+
+	/* Fora da parede, o vizinho é sólido abaixo do chão e acima do teto,
+	 * então basta a parede dele cobrir a borda comum */
+	if(!Builder_GetCoverage(neighbour, edge ^ 1, &covered_min, &covered_max))
+		return false;
+
+	return covered_min <= min && covered_max >= max;
+}
+
+static bool Builder_IsTileLit(const BuilderTiles *tiles, int i, int j) {
+	const WorldLight *light;
+	float min_x = (float) (i * tiles->scale);
+	float min_z = (float) (j * tiles->scale);
+	float dx, dz;
+
+	for(int k = 0; k < tiles->num_lights; k++) {
+		light = &tiles->lights[k];
+
+		dx = fmaxf(fmaxf(min_x - light->position.x, light->position.x - min_x - tiles->scale), 0.0f);
+		dz = fmaxf(fmaxf(min_z - light->position.z, light->position.z - min_z - tiles->scale), 0.0f);
+
+		if(dx * dx + dz * dz < light->radius * light->radius)
+			return true;
+	}
+
+	return false;
+}
+
+static bool Builder_IsPlaneYPlain(const BuilderTiles *tiles, int i, int j, bool ceiling) {
+	const Tile *tile = Builder_GetTile(tiles, i, j);
+	float y = ceiling ? tile->top_height - 0.5f : tile->bot_height + 0.5f;
+
+	if(Builder_IsTileLit(tiles, i, j))
+		return false;
+
+	/* Os tiles que Builder_GetOcclusion olha nos quatro cantos são
+	 * exatamente os 3x3 ao redor do tile */
+	for(int l = -1; l <= 1; l++) {
+		for(int k = -1; k <= 1; k++) {
+			if(Builder_GetSolidity(Builder_GetTile(tiles, i + k, j + l), y) > 0.0f)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool Builder_BlocksLight(const PackedTile *packed) {
+	const WallShape *shape;
+
+	if(packed->top_height <= packed->bot_height)
+		return true;
+
+	shape = WallShape_Get(packed->wall_type);
+
+	return shape->kind == WALLSHAPE_BOX && shape->size_x * shape->size_z >= 1.0f;
+}
+
+static bool Builder_IsLightBlocked(const BuilderTiles *tiles, float x, float z, const Vec3 *light) {
+	float dx = light->x - x;
+	float dz = light->z - z;
+	int i = (int) floorf(x);
+	int j = (int) floorf(z);
+	int step_i = dx > 0.0f ? 1 : -1;
+	int step_j = dz > 0.0f ? 1 : -1;
+	int num_steps = abs((int) floorf(light->x) - i) + abs((int) floorf(light->z) - j);
+	float next_x, next_z, delta_x, delta_z;
+	int local_i, local_j;
+
+	/* Frações do caminho até a próxima linha da grade em x e em z */
+	delta_x = dx != 0.0f ? 1.0f / fabsf(dx) : INFINITY;
+	delta_z = dz != 0.0f ? 1.0f / fabsf(dz) : INFINITY;
+	next_x = dx != 0.0f ? (dx > 0.0f ? i + 1 - x : x - i) * delta_x : INFINITY;
+	next_z = dz != 0.0f ? (dz > 0.0f ? j + 1 - z : z - j) * delta_z : INFINITY;
+
+	/* Anda tile a tile até o da luz, que não conta, para que uma luz
+	 * encostada numa parede ainda acenda */
+	for(int k = 0; k < num_steps; k++) {
+		local_i = i - tiles->shadow_x;
+		local_j = j - tiles->shadow_y;
+
+		if(local_i < 0 || local_j < 0 || local_i >= BUILDER_SHADOW_SIZE || local_j >= BUILDER_SHADOW_SIZE)
+			return false;
+
+		if(tiles->blockers[local_i + local_j * BUILDER_SHADOW_SIZE])
+			return true;
+
+		if(next_x < next_z) {
+			next_x += delta_x;
+			i += step_i;
+		}
+		else {
+			next_z += delta_z;
+			j += step_j;
+		}
+	}
+
+	return false;
+}
+
+static float Builder_GetSolidity(const Tile *tile, float y) {
+	const float epsilon = 0.01f;
+	const WallShape *shape;
+
+	if(tile == NULL || tile->top_height <= tile->bot_height)
+		return 1.0f;
+
+	if(y < tile->bot_height - epsilon || y > tile->top_height + epsilon)
+		return 1.0f;
+
+	shape = WallShape_Get(tile->wall_type);
+
+	/* A parede escurece pela parte do tile que cobre; a diagonal cobre
+	 * metade */
+	switch(shape->kind) {
+		case WALLSHAPE_BOX:
+			return shape->size_x * shape->size_z;
+
+		case WALLSHAPE_DIAGONAL:
+			return 0.5f;
+
+		default:
+			return 0.0f;
+	}
+}
+
+static float Builder_GetOcclusion(const BuilderTiles *tiles, const Vec3 *position, const Vec3 *normal) {
+	float scale = (float) tiles->scale;
+	float x = position->x + normal->x * 0.5f * scale;
+	float y = position->y + normal->y * 0.5f;
+	float z = position->z + normal->z * 0.5f * scale;
+	float occlusion = 0.0f;
+	int num_samples = 0;
+	int i, j;
+
+	/* Olha os tiles encostados no vértice do lado para onde a face
+	 * aponta: quatro para chão e teto, dois para paredes */
+	for(int k = 0; k < 4; k++) {
+		if(normal->x != 0.0f && (k & 1))
+			continue;
+
+		if(normal->z != 0.0f && (k & 2))
+			continue;
+
+		i = (int) floorf((x + (normal->x != 0.0f ? 0.0f : ((k & 1) ? 0.5f : -0.5f) * scale)) / scale);
+		j = (int) floorf((z + (normal->z != 0.0f ? 0.0f : ((k & 2) ? 0.5f : -0.5f) * scale)) / scale);
+
+		/* A cópia só tem um tile de borda ao redor do chunk */
+		if(i < tiles->x - 1 || j < tiles->y - 1 || i > tiles->x + tiles->size || j > tiles->y + tiles->size)
+			continue;
+
+		occlusion += Builder_GetSolidity(Builder_GetTile(tiles, i, j), y);
+		num_samples++;
+	}
+
+	if(num_samples == 0)
+		return 0.0f;
+
+	return occlusion / (float) num_samples;
+}
+
+static void Builder_ShadeVertex(const BuilderContext *context, PackedVertex *vertex, const Vec3 *position, PackedNormal normal) {
+	const BuilderTiles *tiles = context->tiles;
+	const Vec3 *direction = &builder_normals[normal];
+	const WorldLight *light;
+	float occlusion, distance, attenuation, lambert;
+	Vec3 color, to_light;
+
+	occlusion = 1.0f - BUILDER_AO_STRENGTH * Builder_GetOcclusion(tiles, position, direction);
+	Vec3_Mul(&color, &tiles->ambient_light, occlusion);
+
+	for(int i = 0; i < tiles->num_lights; i++) {
+		light = &tiles->lights[i];
+
+		Vec3_Sub(&to_light, &light->position, position);
+		distance = Vec3_Size(&to_light);
+
+		if(distance >= light->radius)
+			continue;
+
+		lambert = distance > 0.001f ? Vec3_Dot(direction, &to_light) / distance : 1.0f;
+
+		if(lambert <= 0.0f)
+			continue;
+
+		if(
+				distance > 0.001f &&
+				Builder_IsLightBlocked(
+					tiles,
+					position->x + (direction->x + to_light.x / distance) * BUILDER_SHADOW_OFFSET,
+					position->z + (direction->z + to_light.z / distance) * BUILDER_SHADOW_OFFSET,
+					&light->position
+					)
+		  )
+			continue;
+
+		attenuation = 1.0f - distance / light->radius;
+		attenuation *= attenuation * lambert;
+
+		color.x += light->color.x * attenuation;
+		color.y += light->color.y * attenuation;
+		color.z += light->color.z * attenuation;
+	}
+
+	vertex->normal = normal;
+	vertex->color[0] = (uint8_t) lroundf(fminf(color.x, 1.0f) * 255.0f);
+	vertex->color[1] = (uint8_t) lroundf(fminf(color.y, 1.0f) * 255.0f);
+	vertex->color[2] = (uint8_t) lroundf(fminf(color.z, 1.0f) * 255.0f);
+	vertex->color[3] = 0xff;
+}
+
+static void Builder_ScalePlane(const BuilderContext *context, Vec3 *position, Vec3 *add, const Vec3 *grid_position, const Vec3 *grid_add) {
+	*position = (Vec3) {grid_position->x * context->scale, grid_position->y, grid_position->z * context->scale};
+	*add = (Vec3) {grid_add->x * context->scale, grid_add->y, grid_add->z * context->scale};
 }
 
-static void Builder_BuildTile(BuilderContext *context, const World *world, int i, int j) {
-	Builder_BuildTileX(context, world, i, j);
-	Builder_BuildTileY(context, world, i, j);
-	Builder_BuildTileZ(context, world, i, j);
-	Builder_BuildTileWall(context, world, i, j);
+static float Builder_GetUvBase(float start, float length) {
+	/* A textura se repete a cada tile, então tirar a parte inteira do uv
+	 * não muda a imagem e mantém o valor dentro do int16_t */
+	return floorf(fminf(start, start + length));
 }
 
-static void Builder_BuildPlaneDiagonal(BuilderContext *context, const Vec3 *position, const Vec3 *add, float texture) {
-	Vertex *vertex;
+static void Builder_BuildPlaneDiagonal(BuilderContext *context, const Vec3 *grid_position, const Vec3 *grid_add, float texture, PackedNormal normal) {
+	PackedVertex *vertices;
 	float add_x, add_y, add_z, u, v;
+	float v_base = Builder_GetUvBase(0.0f, grid_add->y);
+	Vec3 scaled_position, scaled_add, corner;
+	const Vec3 *position = &scaled_position, *add = &scaled_add;
 
-	Builder_AllocVertices(context, 4);
+	if((vertices = Builder_AllocVertices(context, 4)) == NULL)
+		return;
 
-	for(int i = 0; i < 4; i++) {
-		vertex = &context->vertices[context->vcount - i - 1];
+	Builder_ScalePlane(context, &scaled_position, &scaled_add, grid_position, grid_add);
 
+	for(int i = 0; i < 4; i++) {
 		add_x = (i & 1) ? add->x : 0.0f;
 		add_y = (i & 2) ? add->y : 0.0f;
 		add_z = (i & 1) ? add->z : 0.0f;
 
-		u = (i & 1) ? 1.0f : 0.0f;
+		u = (i & 1) ? context->scale : 0.0f;
 		v = (i & 2) ? add->y : 0.0f;
 
-		Vertex_CreateSimple(
-				vertex,
-				position->x + add_x,
-				position->y + add_y,
-				position->z + add_z,
+		corner = (Vec3) {position->x + add_x, position->y + add_y, position->z + add_z};
+
+		PackedVertex_Create(
+				&vertices[3 - i],
+				corner.x - context->origin_x,
+				corner.y,
+				corner.z - context->origin_z,
 				u,
-				v
+				v - v_base,
+				(int) texture
 				);
 
-		vertex->layer_index = texture;
+		Builder_ShadeVertex(context, &vertices[3 - i], &corner, normal);
 	}
+}
 
-	Builder_AllocIndices(context, 6);
-
-	context->indices[context->icount - 1] = context->vcount - 1;
-	context->indices[context->icount - 2] = context->vcount - 2;
-	context->indices[context->icount - 3] = context->vcount - 3;
+static void Builder_BuildPlane(BuilderContext *context, const Vec3 *grid_position, const Vec3 *grid_add, float texture, PackedNormal normal) {
+	PackedVertex *vertices;
+	float add_x, add_y, add_z, u, v, u_base, v_base;
+	Vec3 scaled_position, scaled_add, corner;
+	const Vec3 *position = &scaled_position, *add = &scaled_add;
 
-	context->indices[context->icount - 4] = context->vcount - 4;
-	context->indices[context->icount - 5] = context->vcount - 2;
-	context->indices[context->icount - 6] = context->vcount - 3;
-}
+	if((vertices = Builder_AllocVertices(context, 4)) == NULL)
+		return;
 
-static void Builder_BuildPlane(BuilderContext *context, const Vec3 *position, const Vec3 *add, float texture) {
-	Vertex *vertex;
-	float add_x, add_y, add_z, u, v;
+	Builder_ScalePlane(context, &scaled_position, &scaled_add, grid_position, grid_add);
 
-	Builder_AllocVertices(context, 4);
+	if(add->x == 0.0f) {
+		u_base = Builder_GetUvBase(position->z, add->z);
+		v_base = Builder_GetUvBase(position->y, add->y);
+	}
+	else if(add->y == 0.0f) {
+		u_base = Builder_GetUvBase(position->x, add->x);
+		v_base = Builder_GetUvBase(position->z, add->z);
+	}
+	else {
+		u_base = Builder_GetUvBase(position->x, add->x);
+		v_base = Builder_GetUvBase(position->y, add->y);
+	}
 
 	for(int i = 0; i < 4; i++) {
-		vertex = &context->vertices[context->vcount - i - 1];
-
 		if(add->x == 0.0f) {
 			add_x = 0;
 			add_y = (i & 1) ? add->y : 0.0f;
@@ -353,40 +1566,28 @@ static void Builder_BuildPlane(BuilderContext *context, const Vec3 *position, co
 			v = add_y + position->y;
 		}
 
-		Vertex_CreateSimple(
-				vertex,
-				position->x + add_x,
-				position->y + add_y,
-				position->z + add_z,
-				u,
-				v
+		corner = (Vec3) {position->x + add_x, position->y + add_y, position->z + add_z};
+
+		PackedVertex_Create(
+				&vertices[3 - i],
+				corner.x - context->origin_x,
+				corner.y,
+				corner.z - context->origin_z,
+				u - u_base,
+				v - v_base,
+				(int) texture
 				);
 
-		vertex->layer_index = texture;
+		Builder_ShadeVertex(context, &vertices[3 - i], &corner, normal);
 	}
-
-	Builder_AllocIndices(context, 6);
-
-	context->indices[context->icount - 1] = context->vcount - 1;
-	context->indices[context->icount - 2] = context->vcount - 2;
-	context->indices[context->icount - 3] = context->vcount - 3;
-
-	context->indices[context->icount - 4] = context->vcount - 4;
-	context->indices[context->icount - 5] = context->vcount - 2;
-	context->indices[context->icount - 6] = context->vcount - 3;
 }
 
-static void Builder_BuildPlaneX(BuilderContext *context, const Vec3 *position, float height, float texture) {
+static void Builder_BuildPlaneX(BuilderContext *context, const Vec3 *position, float height, float texture, PackedNormal normal) {
 	Vec3 add = { 0.0f, height, 1.0f };
-	Builder_BuildPlane(context, position, &add, texture);
-}
-
-static void Builder_BuildPlaneY(BuilderContext *context, const Vec3 *position, float texture) {
-	Vec3 add = { 1.0f, 0.0f, 1.0f };
-	Builder_BuildPlane(context, position, &add, texture);
+	Builder_BuildPlane(context, position, &add, texture, normal);
 }
 
-static void Builder_BuildPlaneZ(BuilderContext *context, const Vec3 *position, float height, float texture) {
+static void Builder_BuildPlaneZ(BuilderContext *context, const Vec3 *position, float height, float texture, PackedNormal normal) {
 	Vec3 add = { 1.0f, height, 0.0f };
-	Builder_BuildPlane(context, position, &add, texture);
+	Builder_BuildPlane(context, position, &add, texture, normal);
 }
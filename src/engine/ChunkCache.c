@@ -0,0 +1,229 @@
+#include "engine/ChunkCache.h"
+#include "engine/Builder.h"
+#include "engine/World.h"
+
+#include <string.h>
+
+#define CHUNK_CACHE_FNV_OFFSET 0xcbf29ce484222325ULL
+#define CHUNK_CACHE_FNV_PRIME 0x100000001b3ULL
+
+static uint64_t ChunkCache_Hash(uint64_t hash, const void *data, size_t size);
+static bool ChunkCache_OpenOutput(ChunkCache *cache);
+static bool ChunkCache_Write(ChunkCache *cache, const void *data, size_t size);
+
+bool ChunkCache_Open(ChunkCache *cache, Memory *stack, const World *world, const char *filename) {
+	const ChunkCacheHeader *header;
+	size_t directory_size;
+	int num_chunks = world->chunks_x * world->chunks_y;
+
+	memset(cache, 0, sizeof(ChunkCache));
+	cache->filename = filename;
+	cache->num_chunks = num_chunks;
+	cache->chunks_x = world->chunks_x;
+
+	if(snprintf(cache->temp_filename, sizeof(cache->temp_filename), "%s.tmp", filename) >= (int) sizeof(cache->temp_filename))
+		return false;
+
+	directory_size = (size_t) num_chunks * CHUNK_NUM_LODS * sizeof(ChunkCacheEntry);
+	cache->hashes = Memory_AllocTagged(stack, num_chunks * sizeof(uint64_t), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_BUILDER);
+	cache->entries = Memory_AllocTagged(stack, directory_size, MEMORY_DEFAULT_ALIGNMENT, MEMTAG_BUILDER);
+
+	if(cache->hashes == NULL || cache->entries == NULL)
+		return false;
+
+	/* Chunks que não existem ficam com hash 0 e nunca são achados */
+	memset(cache->hashes, 0, num_chunks * sizeof(uint64_t));
+	memset(cache->entries, 0, directory_size);
+
+	for(int i = 0; i < world->num_chunks; i++)
+		cache->hashes[world->chunks[i]->index] = ChunkCache_HashChunk(world, world->chunks[i]->index);
+
+	if(!File_Map(&cache->view, filename, FILE_ACCESS_SEQUENTIAL))
+		return true;
+
+	header = (const ChunkCacheHeader *) cache->view.data;
+
+	/* Um cache de outra versão ou de outro tamanho de mundo é ignorado */
+	if(
+			cache->view.size < sizeof(ChunkCacheHeader) + directory_size ||
+			memcmp(header->magic, CHUNK_CACHE_MAGIC, 4) != 0 ||
+			header->version != BUILDER_VERSION ||
+			header->num_chunks != (uint32_t) num_chunks ||
+			header->chunks_x != (uint32_t) world->chunks_x ||
+			header->num_lods != CHUNK_NUM_LODS ||
+			header->vertex_size != sizeof(PackedVertex)
+	  ) {
+		File_Release(&cache->view);
+		return true;
+	}
+
+	cache->old_entries = (const ChunkCacheEntry *) (cache->view.data + sizeof(ChunkCacheHeader));
+
+	return true;
+}
+
+uint64_t ChunkCache_HashChunk(const World *world, int chunk) {
+	uint64_t hash = CHUNK_CACHE_FNV_OFFSET;
+	uint32_t version = BUILDER_VERSION;
+	const Chunk *source = World_GetChunk(world, chunk);
+
+	hash = ChunkCache_Hash(hash, &version, sizeof(version));
+
+	/* O builder olha um tile além da borda do chunk, que está na borda
+	 * copiada. Fora do mundo ela guarda sempre o mesmo tile. */
+	hash = ChunkCache_Hash(hash, source->tiles, sizeof(source->tiles));
+	hash = ChunkCache_Hash(hash, source->apron, sizeof(source->apron));
+
+	/* Os LODs olham mais longe, até CHUNK_BUILD_REACH tiles */
+	for(int j = -CHUNK_BUILD_REACH; j < CHUNK_SIZE + CHUNK_BUILD_REACH; j++) {
+		for(int i = -CHUNK_BUILD_REACH; i < CHUNK_SIZE + CHUNK_BUILD_REACH; i++) {
+			if(i >= -1 && j >= -1 && i <= CHUNK_SIZE && j <= CHUNK_SIZE)
+				continue;
+
+			hash = ChunkCache_Hash(hash, World_GetPackedTile(world, source->x + i, source->y + j), sizeof(PackedTile));
+		}
+	}
+
+	/* A luz assada nos vértices também faz parte da mesh */
+	hash = ChunkCache_Hash(hash, &world->ambient_light, sizeof(Vec3));
+
+	for(int i = 0; i < world->num_lights; i++) {
+		if(World_LightReachesChunk(&world->lights[i], source))
+			hash = ChunkCache_Hash(hash, &world->lights[i], sizeof(WorldLight));
+	}
+
+	return hash;
+}
+
+bool ChunkCache_Find(const ChunkCache *cache, int chunk, int lod, const PackedVertex **vertices, size_t *num_vertices) {
+	const ChunkCacheEntry *entry;
+
+	if(cache->old_entries == NULL)
+		return false;
+
+	entry = &cache->old_entries[chunk * CHUNK_NUM_LODS + lod];
+
+	if(entry->offset == 0 || entry->hash != cache->hashes[chunk])
+		return false;
+
+	if(entry->offset > cache->view.size || entry->num_vertices > (cache->view.size - entry->offset) / sizeof(PackedVertex))
+		return false;
+
+	*vertices = (const PackedVertex *) (cache->view.data + entry->offset);
+	*num_vertices = (size_t) entry->num_vertices;
+
+	return true;
+}
+
+bool ChunkCache_Store(ChunkCache *cache, int chunk, int lod, const PackedVertex *vertices, size_t num_vertices) {
+	static const char padding[CHUNK_CACHE_ALIGNMENT] = {0};
+	ChunkCacheEntry *entry = &cache->entries[chunk * CHUNK_NUM_LODS + lod];
+	size_t pad;
+
+	if(cache->out == NULL && !ChunkCache_OpenOutput(cache))
+		return false;
+
+	pad = (CHUNK_CACHE_ALIGNMENT - cache->out_size % CHUNK_CACHE_ALIGNMENT) % CHUNK_CACHE_ALIGNMENT;
+
+	if(!ChunkCache_Write(cache, padding, pad))
+		return false;
+
+	entry->hash = cache->hashes[chunk];
+	entry->offset = cache->out_size;
+	entry->num_vertices = num_vertices;
+
+	return ChunkCache_Write(cache, vertices, num_vertices * sizeof(PackedVertex));
+}
+
+bool ChunkCache_Close(ChunkCache *cache) {
+	ChunkCacheHeader header;
+	const PackedVertex *vertices;
+	size_t num_vertices;
+	bool saved = false;
+
+	/* Se nada foi refeito, o arquivo antigo continua valendo */
+	if(cache->out != NULL) {
+		for(int i = 0; i < cache->num_chunks; i++) {
+			for(int lod = 0; lod < CHUNK_NUM_LODS; lod++) {
+				if(cache->entries[i * CHUNK_NUM_LODS + lod].offset == 0 && ChunkCache_Find(cache, i, lod, &vertices, &num_vertices))
+					ChunkCache_Store(cache, i, lod, vertices, num_vertices);
+			}
+		}
+
+		memcpy(header.magic, CHUNK_CACHE_MAGIC, 4);
+		header.version = BUILDER_VERSION;
+		header.num_chunks = cache->num_chunks;
+		header.num_lods = CHUNK_NUM_LODS;
+		header.vertex_size = sizeof(PackedVertex);
+		header.chunks_x = cache->chunks_x;
+
+		if(fseek(cache->out, 0, SEEK_SET) != 0)
+			cache->failed = true;
+
+		ChunkCache_Write(cache, &header, sizeof(header));
+		ChunkCache_Write(cache, cache->entries, (size_t) cache->num_chunks * CHUNK_NUM_LODS * sizeof(ChunkCacheEntry));
+
+		if(fclose(cache->out) != 0)
+			cache->failed = true;
+
+		cache->out = NULL;
+		saved = !cache->failed;
+	}
+
+	File_Release(&cache->view);
+	cache->old_entries = NULL;
+
+	if(saved && rename(cache->temp_filename, cache->filename) != 0)
+		saved = false;
+
+	if(cache->failed) {
+		fprintf(stderr, "Failed to write chunk cache %s.\n", cache->filename);
+		remove(cache->temp_filename);
+	}
+
+	return !cache->failed;
+}
+
+static uint64_t ChunkCache_Hash(uint64_t hash, const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char *) data;
+
+	for(size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= CHUNK_CACHE_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static bool ChunkCache_OpenOutput(ChunkCache *cache) {
+	ChunkCacheHeader header = {0};
+
+	if(cache->failed)
+		return false;
+
+	cache->out = fopen(cache->temp_filename, "wb");
+
+	if(cache->out == NULL) {
+		cache->failed = true;
+		return false;
+	}
+
+	cache->out_size = 0;
+
+	/* O cabeçalho e o diretório são reescritos no ChunkCache_Close */
+	return ChunkCache_Write(cache, &header, sizeof(header)) && ChunkCache_Write(cache, cache->entries, (size_t) cache->num_chunks * CHUNK_NUM_LODS * sizeof(ChunkCacheEntry));
+}
+
+static bool ChunkCache_Write(ChunkCache *cache, const void *data, size_t size) {
+	if(cache->failed)
+		return false;
+
+	if(size > 0 && fwrite(data, 1, size, cache->out) != size) {
+		cache->failed = true;
+		return false;
+	}
+
+	cache->out_size += size;
+
+	return true;
+}
@@ -47,7 +47,7 @@ static bool Entity_CheckCollisionWorld(const Entity *entity, const World *world)
 
 static void Entity_HandleFloorTolerance(Entity *entity, const World *world) {
 	int min_x, min_z, max_x, max_z;
-	const Tile *tile;
+	Tile tile;
 
 	float max_floor_height = -999.0f;
 
@@ -62,12 +62,10 @@ static void Entity_HandleFloorTolerance(Entity *entity, const World *world) {
 
 	for(int i = min_x; i < max_x; i++) {
 		for(int j = min_z; j < max_z; j++) {
-			tile = World_GetTile(world, i, j);
-
-			if(tile == NULL)
+			if(!World_GetTile(world, i, j, &tile))
 				continue;
 
-			max_floor_height = max_floor_height > tile->bot_height ? max_floor_height : tile->bot_height;
+			max_floor_height = max_floor_height > tile.bot_height ? max_floor_height : tile.bot_height;
 		}
 	}
 
@@ -1,9 +1,58 @@
 #include "engine/Game.h"
 #include "renderer/Render.h"
 #include "engine/Builder.h"
+#include "engine/TileRenderer.h"
 #include "engine/World.h"
 #include "engine/Entity.h"
+#include "engine/Level.h"
+#include "engine/Streamer.h"
 
+#include <string.h>
+
+#define FRAME_MEMORY ( 1024 * 1024 )
+#define CHUNK_CACHE_FILE "chunks.cache"
+
+/* Gerado de res/levels/test.txt pelo level_convert. O CMake define
+ * LEVEL_DIR como o diretório dos níveis no build. */
+#ifndef LEVEL_DIR
+#define LEVEL_DIR "res/levels/"
+#endif
+
+#define LEVEL_FILE LEVEL_DIR "test.level"
+
+/* Parte do quadro de ~6 ms a 165 fps que pode ir para uploads de chunks */
+#define CHUNK_UPLOAD_BUDGET_MS 1.5f
+
+/* Streaming: raio de carga e de descarte em chunks, segundos de
+ * movimento carregados à frente e os limites de memória. 64 chunks de
+ * tiles dão ~3 MB. */
+#define STREAM_LOAD_RADIUS 2
+#define STREAM_UNLOAD_RADIUS 3
+#define STREAM_PREFETCH_SECONDS 2.0f
+#define STREAM_LOADS_PER_FRAME 2
+#define STREAM_MAX_CHUNKS 64
+#define STREAM_MAX_MESH_BYTES ( (size_t) 64 * 1024 * 1024 )
+
+/* Com STREAM_WORLD os chunks são lidos de LEVEL_FILE ao redor do jogador
+ * e descartados quando ficam longe, em vez de o nível inteiro ficar na
+ * memória. Não funciona com GPU_TILES, que sobe a grade inteira. */
+#ifdef STREAM_WORLD
+#define GAME_STREAM_WORLD true
+#else
+#define GAME_STREAM_WORLD false
+#endif
+
+/* Com GPU_TILES o mundo é desenhado pelo TileRenderer e o Builder não é
+ * usado */
+#ifdef GPU_TILES
+#define GAME_GPU_TILES true
+#else
+#define GAME_GPU_TILES false
+#endif
+
+static bool Game_LoadLevel(Game *game);
+static bool Game_CreateStreamer(Game *game);
+static bool Game_CopySpawns(Game *game, const Level *level);
 static void Game_Update(Game *game);
 static void Game_Render(Game *game);
 static void Game_Loop(Game *game);
@@ -11,52 +60,58 @@ static void Game_Loop(Game *game);
 Game * Game_Create(Context *context) {
 	Game *game;
 
-	game = Memory_Alloc(context->memory, sizeof(Game));
+	game = Memory_AllocTagged(context->memory, sizeof(Game), MEMORY_CACHE_LINE, MEMTAG_GAME);
 
 	game->context = context;
 
-	for(int i = 0; i < WORLD_SIZE; i++) {
-		for(int j = 0; j < WORLD_SIZE; j++) {
-			Tile tile = {
-				.bot_height = 0.0f,
-				.top_height = 4.0f,
-				.bot_texture = 0,
-				.top_texture = 0,
-				.wall_texture = 1,
-				.bot_window_texture = 1,
-				.top_window_texture = 1,
-				.wall_type = WALLTYPE_NONE,
-			};
-
-			World_EditTile(&game->world, i, j, &tile);
-		}
-	}
+	game->builder = NULL;
+	game->tile_renderer = NULL;
+	game->streamer = NULL;
+	game->player = NULL;
+	game->spawns = NULL;
+	game->num_spawns = 0;
 
-	for(int i = 1; i <= 4; i++){
-		Tile tile = {
-			.bot_height = (float) i / 8.0f,
-			.top_height = 2.0f,
-			.bot_texture = 0,
-			.top_texture = 0,
-			.wall_texture = 1,
-			.bot_window_texture = 1,
-			.top_window_texture = 1,
-			.wall_type = WALLTYPE_NONE,
-		};
-	
-		World_EditTile(&game->world, 5 + i, 5, &tile);
+	if(GAME_STREAM_WORLD) {
+		if(!Game_CreateStreamer(game))
+			return NULL;
+	}
+	else if(!Game_LoadLevel(game)) {
+		return NULL;
 	}
 
 	game->world.collision_layer = 1;
 
-	Builder_BuildMesh(context->stack, &game->world);
+	if(GAME_GPU_TILES && !GAME_STREAM_WORLD) {
+		game->tile_renderer = Memory_AllocTagged(context->memory, sizeof(TileRenderer), MEMORY_CACHE_LINE, MEMTAG_RENDERER);
+
+		if(game->tile_renderer == NULL || !TileRenderer_Create(game->tile_renderer, context->stack, &game->world)) {
+			fprintf(stderr, "Failed to create the tile renderer.\n");
+			return NULL;
+		}
+	}
+	else {
+		/* Com streaming o mundo começa vazio e os chunks vão para o
+		 * Builder conforme são carregados */
+		if(!GAME_STREAM_WORLD)
+			Builder_BuildMesh(context->stack, &game->world, CHUNK_CACHE_FILE);
+
+		Shader_LoadFiles(&game->world.shader, context->stack, "res/shaders/chunk.vs", "res/shaders/chunk.fs");
+	}
 
-	Shader_Load(&game->world.shader,
-			Memory_ReadFileAsString(context->memory, "res/shaders/octree.vs"),
-			Memory_ReadFileAsString(context->memory, "res/shaders/octree.fs")
-			);
 	Memory_Free(context->stack);
 
+	if(!FrameMemory_Create(&game->frame, context->stack, FRAME_MEMORY)) {
+		fprintf(stderr, "Not enough memory for the frame buffers.\n");
+		return NULL;
+	}
+
+	if(game->tile_renderer == NULL) {
+		game->builder = Builder_Create(context->memory, &game->world);
+
+		if(game->builder == NULL)
+			return NULL;
+	}
+
 	TextureArray_Create(&game->world.tile_textures, 64, 64);
 	TextureArray_Load(&game->world.tile_textures, "floor.png");
 	TextureArray_Load(&game->world.tile_textures, "wall.png");
@@ -85,6 +140,19 @@ void Game_Run(Game *game) {
 	}
 }
 
+void Game_Destroy(Game *game) {
+	if(game->builder != NULL)
+		Builder_Destroy(game->builder);
+
+	if(game->tile_renderer != NULL)
+		TileRenderer_Destroy(game->tile_renderer);
+
+	if(game->streamer != NULL) {
+		Streamer_PrintStats(game->streamer);
+		Streamer_Destroy(game->streamer);
+	}
+}
+
 Entity * Game_AddEntity(Game *game) {
 	Entity *entity;
 
@@ -101,6 +169,67 @@ Entity * Game_AddEntity(Game *game) {
 	return NULL;
 }
 
+static bool Game_LoadLevel(Game *game) {
+	Context *context = game->context;
+	Level level;
+	bool ok;
+
+	/* O nível inteiro fica no mundo, então o Level só vive até aqui */
+	if(!Level_Open(&level, context->stack, LEVEL_FILE)) {
+		fprintf(stderr, "Failed to open level %s.\n", LEVEL_FILE);
+		return false;
+	}
+
+	ok = Level_CreateWorld(&level, &game->world, context->memory, level.num_chunks > 0 ? level.num_chunks : 1);
+	ok = ok && Level_LoadChunks(&level, &game->world);
+	ok = ok && Game_CopySpawns(game, &level);
+
+	Level_Close(&level);
+
+	return ok;
+}
+
+static bool Game_CreateStreamer(Game *game) {
+	Context *context = game->context;
+	const StreamerConfig config = {
+		.load_radius = STREAM_LOAD_RADIUS,
+		.unload_radius = STREAM_UNLOAD_RADIUS,
+		.prefetch_seconds = STREAM_PREFETCH_SECONDS,
+		.max_loads = STREAM_LOADS_PER_FRAME,
+		.max_chunks = STREAM_MAX_CHUNKS,
+		.max_mesh_bytes = STREAM_MAX_MESH_BYTES,
+	};
+
+	game->streamer = Memory_AllocTagged(context->memory, sizeof(Streamer), MEMORY_CACHE_LINE, MEMTAG_WORLD);
+
+	if(game->streamer == NULL)
+		return false;
+
+	if(!Streamer_Create(game->streamer, context->memory, &game->world, LEVEL_FILE, &config)) {
+		fprintf(stderr, "Failed to open level %s.\n", LEVEL_FILE);
+		game->streamer = NULL;
+		return false;
+	}
+
+	return Game_CopySpawns(game, &game->streamer->level);
+}
+
+static bool Game_CopySpawns(Game *game, const Level *level) {
+	game->num_spawns = (int) level->header->num_spawns;
+
+	if(game->num_spawns == 0)
+		return true;
+
+	game->spawns = Memory_AllocTagged(game->context->memory, game->num_spawns * sizeof(LevelSpawn), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_ENTITIES);
+
+	if(game->spawns == NULL)
+		return false;
+
+	memcpy(game->spawns, level->spawns, game->num_spawns * sizeof(LevelSpawn));
+
+	return true;
+}
+
 static void Game_Update(Game *game) {
 	for(int i = 0; i < MAX_ENTITIES; i++) {
 		Entity *entity = &game->entities[i];
@@ -113,14 +242,30 @@ static void Game_Update(Game *game) {
 
 static void Game_Render(Game *game) {
 	Render_Clear(game->context, 0x00, 0x00, 0x00, 0xff);
-	World_Render(&game->world, &game->view, &game->projection);
+
+	if(game->tile_renderer != NULL)
+		TileRenderer_Render(game->tile_renderer, &game->world, &game->view, &game->projection);
+	else
+		World_Render(&game->world, &game->view, &game->projection);
+
 	Render_Present(game->context);
 }
 
 static void Game_Loop(Game *game) {
+	FrameMemory_Swap(&game->frame);
+
 	Context_PollEvent(game->context);
 
 	Game_Update(game);
+
+	if(game->streamer != NULL && game->player != NULL)
+		Streamer_Update(game->streamer, &game->world, &game->player->position, &game->player->velocity);
+
+	if(game->builder != NULL) {
+		Builder_QueueDirtyChunks(game->builder);
+		Builder_UploadReady(game->builder, CHUNK_UPLOAD_BUDGET_MS);
+	}
+
 	Game_Render(game);
 
 	Context_DelayFPS(game->context);
@@ -0,0 +1,282 @@
+#include "engine/Level.h"
+#include "engine/World.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define LEVEL_FNV_OFFSET 0xcbf29ce484222325ULL
+#define LEVEL_FNV_PRIME 0x100000001b3ULL
+
+#define LEVEL_BLOCK_SIZE ( CHUNK_SIZE * CHUNK_SIZE * sizeof(PackedTile) )
+
+typedef char level_header_size_check[sizeof(LevelHeader) == 40 ? 1 : -1];
+typedef char level_spawn_size_check[sizeof(LevelSpawn) == 20 ? 1 : -1];
+typedef char level_light_size_check[sizeof(WorldLight) == 28 ? 1 : -1];
+
+static uint64_t Level_Hash(uint64_t hash, const void *data, size_t size);
+static uint64_t Level_HashHeader(const LevelHeader *header, const void *tables, size_t tables_size);
+static bool Level_Write(FILE *file, const void *data, size_t size);
+
+bool Level_Open(Level *level, Memory *mems, const char *filename) {
+	const LevelHeader *header;
+	const LevelChunkEntry *entry;
+	size_t directory_size, tables_size;
+	int num_entries;
+
+	memset(level, 0, sizeof(Level));
+
+	/* Os chunks são lidos fora de ordem, conforme o jogador anda */
+	if(!File_Open(&level->view, mems, filename, FILE_ACCESS_RANDOM))
+		return false;
+
+	header = (const LevelHeader *) level->view.data;
+
+	if(
+			level->view.size < sizeof(LevelHeader) ||
+			memcmp(header->magic, LEVEL_MAGIC, 4) != 0 ||
+			header->version != LEVEL_VERSION ||
+			header->chunk_size != CHUNK_SIZE ||
+			header->tile_size != sizeof(PackedTile) ||
+			header->chunks_x == 0 || header->chunks_y == 0 ||
+			header->chunks_x > INT16_MAX || header->chunks_y > INT16_MAX ||
+			header->num_spawns > INT16_MAX || header->num_lights > WORLD_MAX_LIGHTS
+	  ) {
+		fprintf(stderr, "%s is not a level of this version.\n", filename);
+		Level_Close(level);
+		return false;
+	}
+
+	num_entries = (int) (header->chunks_x * header->chunks_y);
+	directory_size = (size_t) num_entries * sizeof(LevelChunkEntry);
+	tables_size = directory_size + header->num_spawns * sizeof(LevelSpawn) + header->num_lights * sizeof(WorldLight);
+
+	if(level->view.size - sizeof(LevelHeader) < tables_size) {
+		fprintf(stderr, "%s is truncated.\n", filename);
+		Level_Close(level);
+		return false;
+	}
+
+	if(Level_HashHeader(header, level->view.data + sizeof(LevelHeader), tables_size) != header->checksum) {
+		fprintf(stderr, "%s is corrupt.\n", filename);
+		Level_Close(level);
+		return false;
+	}
+
+	level->header = header;
+	level->entries = (const LevelChunkEntry *) (level->view.data + sizeof(LevelHeader));
+	level->spawns = (const LevelSpawn *) (level->view.data + sizeof(LevelHeader) + directory_size);
+	level->lights = (const WorldLight *) (level->spawns + header->num_spawns);
+	level->chunks_x = (int) header->chunks_x;
+	level->chunks_y = (int) header->chunks_y;
+
+	/* Só o diretório é conferido aqui; os tiles ficam no disco até o
+	 * chunk ser pedido */
+	for(int i = 0; i < num_entries; i++) {
+		entry = &level->entries[i];
+
+		if(entry->offset == 0)
+			continue;
+
+		if(entry->offset % LEVEL_ALIGNMENT != 0 || entry->offset > level->view.size || LEVEL_BLOCK_SIZE > level->view.size - entry->offset) {
+			fprintf(stderr, "%s has a bad chunk directory.\n", filename);
+			Level_Close(level);
+			return false;
+		}
+
+		level->num_chunks++;
+	}
+
+	level->states = Memory_AllocTagged(mems, num_entries, MEMORY_DEFAULT_ALIGNMENT, MEMTAG_WORLD);
+
+	if(level->states == NULL) {
+		Level_Close(level);
+		return false;
+	}
+
+	memset(level->states, LEVEL_CHUNK_UNCHECKED, num_entries);
+
+	return true;
+}
+
+bool Level_HasChunk(const Level *level, int index) {
+	if(index < 0 || index >= level->chunks_x * level->chunks_y)
+		return false;
+
+	return level->entries[index].offset != 0 && level->states[index] != LEVEL_CHUNK_CORRUPT;
+}
+
+const PackedTile * Level_GetChunkTiles(Level *level, int index) {
+	const LevelChunkEntry *entry;
+	const char *block;
+
+	if(!Level_HasChunk(level, index))
+		return NULL;
+
+	entry = &level->entries[index];
+	block = level->view.data + entry->offset;
+
+	if(level->states[index] == LEVEL_CHUNK_UNCHECKED) {
+		if(Level_Hash(LEVEL_FNV_OFFSET, block, LEVEL_BLOCK_SIZE) != entry->checksum) {
+			fprintf(stderr, "Chunk %d of the level is corrupt.\n", index);
+			level->states[index] = LEVEL_CHUNK_CORRUPT;
+			return NULL;
+		}
+
+		level->states[index] = LEVEL_CHUNK_VALID;
+	}
+
+	return (const PackedTile *) block;
+}
+
+bool Level_CreateWorld(const Level *level, World *world, Memory *memory, int max_chunks) {
+	if(!World_Create(world, memory, level->chunks_x * CHUNK_SIZE, level->chunks_y * CHUNK_SIZE, max_chunks)) {
+		fprintf(stderr, "Not enough memory for the world.\n");
+		return false;
+	}
+
+	for(uint32_t i = 0; i < level->header->num_lights; i++) {
+		if(!World_AddLight(world, &level->lights[i].position, &level->lights[i].color, level->lights[i].radius)) {
+			fprintf(stderr, "Light %u of the level has a bad radius.\n", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Level_LoadChunks(Level *level, World *world) {
+	const PackedTile *tiles;
+	bool ok = true;
+
+	for(int i = 0; i < level->chunks_x * level->chunks_y; i++) {
+		tiles = Level_GetChunkTiles(level, i);
+
+		if(tiles == NULL)
+			continue;
+
+		if(World_LoadChunk(world, i, tiles) == NULL)
+			ok = false;
+	}
+
+	return ok;
+}
+
+bool Level_Save(const World *world, const LevelSpawn *spawns, int num_spawns, const char *filename) {
+	static const char padding[LEVEL_ALIGNMENT] = {0};
+	LevelHeader header;
+	LevelChunkEntry entry;
+	const Chunk *chunk;
+	uint64_t offset, hash;
+	size_t num_entries = (size_t) world->chunks_x * world->chunks_y;
+	size_t pad;
+	bool ok;
+	FILE *file;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, LEVEL_MAGIC, 4);
+	header.version = LEVEL_VERSION;
+	header.chunk_size = CHUNK_SIZE;
+	header.tile_size = sizeof(PackedTile);
+	header.chunks_x = world->chunks_x;
+	header.chunks_y = world->chunks_y;
+	header.num_spawns = num_spawns;
+	header.num_lights = world->num_lights;
+
+	file = fopen(filename, "wb");
+
+	if(file == NULL)
+		return false;
+
+	offset = sizeof(LevelHeader) + num_entries * sizeof(LevelChunkEntry);
+	offset += num_spawns * sizeof(LevelSpawn) + world->num_lights * sizeof(WorldLight);
+	pad = (LEVEL_ALIGNMENT - offset % LEVEL_ALIGNMENT) % LEVEL_ALIGNMENT;
+	offset += pad;
+
+	/* O cabeçalho é reescrito com o checksum no fim */
+	ok = Level_Write(file, &header, sizeof(header));
+	hash = Level_Hash(LEVEL_FNV_OFFSET, &header, sizeof(header));
+
+	/* Os blocos seguem a ordem da grade, para que chunks vizinhos em x
+	 * fiquem perto no arquivo */
+	for(size_t i = 0; i < num_entries && ok; i++) {
+		chunk = World_GetChunk(world, (int) i);
+		entry = (LevelChunkEntry) {0, 0};
+
+		if(chunk != NULL) {
+			entry.offset = offset;
+			entry.checksum = Level_Hash(LEVEL_FNV_OFFSET, chunk->tiles, LEVEL_BLOCK_SIZE);
+			offset += LEVEL_BLOCK_SIZE;
+		}
+
+		ok = Level_Write(file, &entry, sizeof(entry));
+		hash = Level_Hash(hash, &entry, sizeof(entry));
+	}
+
+	ok = ok && Level_Write(file, spawns, num_spawns * sizeof(LevelSpawn));
+	ok = ok && Level_Write(file, world->lights, world->num_lights * sizeof(WorldLight));
+	ok = ok && Level_Write(file, padding, pad);
+
+	hash = Level_Hash(hash, spawns, num_spawns * sizeof(LevelSpawn));
+	hash = Level_Hash(hash, world->lights, world->num_lights * sizeof(WorldLight));
+
+	for(size_t i = 0; i < num_entries && ok; i++) {
+		chunk = World_GetChunk(world, (int) i);
+
+		if(chunk != NULL)
+			ok = Level_Write(file, chunk->tiles, LEVEL_BLOCK_SIZE);
+	}
+
+	header.checksum = hash;
+
+	if(ok && fseek(file, 0, SEEK_SET) != 0)
+		ok = false;
+
+	ok = ok && Level_Write(file, &header, sizeof(header));
+
+	if(fclose(file) != 0)
+		ok = false;
+
+	if(!ok) {
+		fprintf(stderr, "Failed to write level %s.\n", filename);
+		remove(filename);
+	}
+
+	return ok;
+}
+
+void Level_Close(Level *level) {
+	File_Release(&level->view);
+
+	/* states pertence à memória de quem abriu */
+	level->header = NULL;
+	level->entries = NULL;
+	level->spawns = NULL;
+	level->lights = NULL;
+	level->states = NULL;
+	level->chunks_x = 0;
+	level->chunks_y = 0;
+	level->num_chunks = 0;
+}
+
+static uint64_t Level_Hash(uint64_t hash, const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char *) data;
+
+	for(size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= LEVEL_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static uint64_t Level_HashHeader(const LevelHeader *header, const void *tables, size_t tables_size) {
+	LevelHeader copy = *header;
+
+	copy.checksum = 0;
+
+	return Level_Hash(Level_Hash(LEVEL_FNV_OFFSET, &copy, sizeof(copy)), tables, tables_size);
+}
+
+static bool Level_Write(FILE *file, const void *data, size_t size) {
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
@@ -0,0 +1,245 @@
+#include "engine/Streamer.h"
+#include "engine/World.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/* Chunk do jogador e chunk onde ele estará depois de prefetch_seconds */
+typedef struct {
+	int x, y;
+	int ahead_x, ahead_y;
+} StreamerFocus;
+
+static void Streamer_SetFocus(StreamerFocus *focus, const Streamer *streamer, const Vec3 *position, const Vec3 *velocity);
+static int Streamer_GetDistance(const StreamerFocus *focus, int x, int y);
+static size_t Streamer_GetMeshBytes(const Streamer *streamer, const Chunk *chunk);
+static int Streamer_FindMissing(const Streamer *streamer, const World *world, const StreamerFocus *focus, int *distance);
+static bool Streamer_EvictFarthest(Streamer *streamer, World *world, const StreamerFocus *focus, int distance);
+static void Streamer_Evict(Streamer *streamer, World *world, Chunk *chunk);
+
+bool Streamer_Create(Streamer *streamer, Memory *memory, World *world, const char *filename, const StreamerConfig *config) {
+	streamer->config = *config;
+
+	if(streamer->config.unload_radius < streamer->config.load_radius)
+		streamer->config.unload_radius = streamer->config.load_radius;
+
+	streamer->mesh_bytes = 0;
+	streamer->average_mesh_bytes = 0;
+	streamer->peak_mesh_bytes = 0;
+	streamer->peak_chunks = 0;
+	streamer->num_loads = 0;
+	streamer->num_evictions = 0;
+
+	if(!Level_Open(&streamer->level, memory, filename))
+		return false;
+
+	if(!Level_CreateWorld(&streamer->level, world, memory, config->max_chunks)) {
+		Level_Close(&streamer->level);
+		return false;
+	}
+
+	return true;
+}
+
+void Streamer_Update(Streamer *streamer, World *world, const Vec3 *position, const Vec3 *velocity) {
+	StreamerFocus focus;
+	const PackedTile *tiles;
+	Chunk *chunk;
+	int index, distance, num_built;
+
+	Streamer_SetFocus(&focus, streamer, position, velocity);
+
+	/* Percorre de trás para frente porque World_FreeChunk traz o último
+	 * chunk da lista para o lugar do que saiu */
+	for(int i = world->num_chunks - 1; i >= 0; i--) {
+		chunk = world->chunks[i];
+
+		if(Streamer_GetDistance(&focus, chunk->x / CHUNK_SIZE, chunk->y / CHUNK_SIZE) > streamer->config.unload_radius)
+			Streamer_Evict(streamer, world, chunk);
+	}
+
+	/* As meshes mudam de tamanho a cada upload do Builder. Os chunks que
+	 * ainda não têm mesh contam pela média dos outros, senão vários
+	 * entrariam antes de o primeiro chegar à GPU. */
+	streamer->mesh_bytes = 0;
+	num_built = 0;
+
+	for(int i = 0; i < world->num_chunks; i++) {
+		if(world->chunks[i]->lods[0].vao != 0) {
+			streamer->mesh_bytes += Streamer_GetMeshBytes(streamer, world->chunks[i]);
+			num_built++;
+		}
+	}
+
+	if(num_built > 0)
+		streamer->average_mesh_bytes = streamer->mesh_bytes / num_built;
+
+	streamer->mesh_bytes += (size_t) (world->num_chunks - num_built) * streamer->average_mesh_bytes;
+
+	if(streamer->mesh_bytes > streamer->peak_mesh_bytes)
+		streamer->peak_mesh_bytes = streamer->mesh_bytes;
+
+	for(int n = 0; n < streamer->config.max_loads; n++) {
+		index = Streamer_FindMissing(streamer, world, &focus, &distance);
+
+		if(index < 0)
+			break;
+
+		/* Um bloco corrompido fica marcado no Level e o chunk continua
+		 * sólido */
+		tiles = Level_GetChunkTiles(&streamer->level, index);
+
+		if(tiles == NULL)
+			continue;
+
+		if(world->num_chunks >= world->max_chunks || streamer->mesh_bytes > streamer->config.max_mesh_bytes) {
+			if(!Streamer_EvictFarthest(streamer, world, &focus, distance))
+				break;
+		}
+
+		if(World_LoadChunk(world, index, tiles) == NULL)
+			break;
+
+		/* O chunk ainda não tem malha; conta a média para que o teto
+		 * valha já nas próximas cargas deste quadro */
+		streamer->mesh_bytes += streamer->average_mesh_bytes;
+		streamer->num_loads++;
+	}
+
+	if(streamer->mesh_bytes > streamer->peak_mesh_bytes)
+		streamer->peak_mesh_bytes = streamer->mesh_bytes;
+
+	if(world->num_chunks > streamer->peak_chunks)
+		streamer->peak_chunks = world->num_chunks;
+}
+
+void Streamer_PrintStats(const Streamer *streamer) {
+	printf(
+			"streamer: %d loads, %d evictions, peak %d chunks (%lu KB of tiles), peak %lu KB of meshes\n",
+			streamer->num_loads,
+			streamer->num_evictions,
+			streamer->peak_chunks,
+			(unsigned long) (streamer->peak_chunks * sizeof(Chunk) / 1024),
+			(unsigned long) (streamer->peak_mesh_bytes / 1024)
+			);
+}
+
+void Streamer_Destroy(Streamer *streamer) {
+	Level_Close(&streamer->level);
+}
+
+static void Streamer_SetFocus(StreamerFocus *focus, const Streamer *streamer, const Vec3 *position, const Vec3 *velocity) {
+	float ahead_x = position->x + velocity->x * streamer->config.prefetch_seconds;
+	float ahead_z = position->z + velocity->z * streamer->config.prefetch_seconds;
+
+	focus->x = (int) floorf(position->x / CHUNK_SIZE);
+	focus->y = (int) floorf(position->z / CHUNK_SIZE);
+	focus->ahead_x = (int) floorf(ahead_x / CHUNK_SIZE);
+	focus->ahead_y = (int) floorf(ahead_z / CHUNK_SIZE);
+}
+
+static int Streamer_GetDistance(const StreamerFocus *focus, int x, int y) {
+	int distance = abs(x - focus->x);
+	int ahead = abs(x - focus->ahead_x);
+
+	if(abs(y - focus->y) > distance)
+		distance = abs(y - focus->y);
+
+	if(abs(y - focus->ahead_y) > ahead)
+		ahead = abs(y - focus->ahead_y);
+
+	/* Na mesma distância, os chunks ao redor do jogador vêm antes dos
+	 * chunks à frente */
+	return ahead + 1 < distance ? ahead + 1 : distance;
+}
+
+static size_t Streamer_GetMeshBytes(const Streamer *streamer, const Chunk *chunk) {
+	size_t size = 0;
+
+	if(chunk->lods[0].vao == 0)
+		return streamer->average_mesh_bytes;
+
+	/* O index buffer dos quads é compartilhado e não entra na conta */
+	for(int lod = 0; lod < CHUNK_NUM_LODS; lod++)
+		size += (size_t) chunk->lods[lod].num_quads * 4 * sizeof(PackedVertex);
+
+	return size;
+}
+
+static int Streamer_FindMissing(const Streamer *streamer, const World *world, const StreamerFocus *focus, int *distance) {
+	int radius = streamer->config.load_radius;
+	int min_x, min_y, max_x, max_y;
+	int best = -1, index, d;
+
+	min_x = (focus->x < focus->ahead_x ? focus->x : focus->ahead_x) - radius;
+	min_y = (focus->y < focus->ahead_y ? focus->y : focus->ahead_y) - radius;
+	max_x = (focus->x > focus->ahead_x ? focus->x : focus->ahead_x) + radius;
+	max_y = (focus->y > focus->ahead_y ? focus->y : focus->ahead_y) + radius;
+
+	if(min_x < 0)
+		min_x = 0;
+
+	if(min_y < 0)
+		min_y = 0;
+
+	if(max_x >= world->chunks_x)
+		max_x = world->chunks_x - 1;
+
+	if(max_y >= world->chunks_y)
+		max_y = world->chunks_y - 1;
+
+	*distance = radius + 1;
+
+	for(int y = min_y; y <= max_y; y++) {
+		for(int x = min_x; x <= max_x; x++) {
+			d = Streamer_GetDistance(focus, x, y);
+
+			if(d >= *distance)
+				continue;
+
+			index = x + y * world->chunks_x;
+
+			/* Chunks vazios no nível continuam faltando, e sólidos */
+			if(!Level_HasChunk(&streamer->level, index) || World_GetChunk(world, index) != NULL)
+				continue;
+
+			best = index;
+			*distance = d;
+		}
+	}
+
+	return best;
+}
+
+static bool Streamer_EvictFarthest(Streamer *streamer, World *world, const StreamerFocus *focus, int distance) {
+	Chunk *farthest = NULL;
+	int d;
+
+	/* Só troca por um chunk mais longe que o que vai entrar, senão os
+	 * dois ficariam se revezando */
+	for(int i = 0; i < world->num_chunks; i++) {
+		d = Streamer_GetDistance(focus, world->chunks[i]->x / CHUNK_SIZE, world->chunks[i]->y / CHUNK_SIZE);
+
+		if(d > distance) {
+			distance = d;
+			farthest = world->chunks[i];
+		}
+	}
+
+	if(farthest == NULL)
+		return false;
+
+	Streamer_Evict(streamer, world, farthest);
+
+	return true;
+}
+
+static void Streamer_Evict(Streamer *streamer, World *world, Chunk *chunk) {
+	size_t size = Streamer_GetMeshBytes(streamer, chunk);
+
+	streamer->mesh_bytes -= size < streamer->mesh_bytes ? size : streamer->mesh_bytes;
+	streamer->num_evictions++;
+
+	World_FreeChunk(world, chunk->index);
+}
@@ -0,0 +1,187 @@
+#include "engine/TileRenderer.h"
+#include "engine/World.h"
+#include "engine/WallShape.h"
+
+#include <stdio.h>
+#include <math.h>
+
+#define TILE_RENDERER_TEXTURE_UNIT 1
+
+/* Tamanho de wall_boxes e wall_diagonals em tiles.vs */
+#define TILE_RENDERER_SHADER_WALLTYPES 11
+
+typedef char tile_renderer_walltypes_check[WALLTYPE_NUMTYPES == TILE_RENDERER_SHADER_WALLTYPES ? 1 : -1];
+
+/* Tiles de chunks que não existem viram colunas sólidas */
+static const Tile tile_renderer_solid_tile = { .wall_type = WALLTYPE_BLOCK };
+
+static void TileRenderer_PackTile(int16_t *texels, const Tile *tile);
+static bool TileRenderer_SetShapes(const TileRenderer *renderer, const World *world);
+
+bool TileRenderer_Create(TileRenderer *renderer, Memory *stack, const World *world) {
+	MemoryScope scope = Memory_BeginScope(stack);
+	int width = world->width * TILE_RENDERER_TEXELS_PER_TILE;
+	int16_t *texels;
+	Tile tile;
+
+	renderer->tile_texture = 0;
+	renderer->vao = 0;
+	renderer->shader.id = 0;
+
+	texels = Memory_AllocTagged(stack, (size_t) width * world->height * 4 * sizeof(int16_t), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_RENDERER);
+
+	if(texels == NULL) {
+		fprintf(stderr, "Not enough memory for the tile texture.\n");
+		Memory_EndScope(&scope);
+		return false;
+	}
+
+	for(int j = 0; j < world->height; j++) {
+		for(int i = 0; i < world->width; i++) {
+			if(!World_GetTile(world, i, j, &tile))
+				tile = tile_renderer_solid_tile;
+
+			TileRenderer_PackTile(&texels[(i * TILE_RENDERER_TEXELS_PER_TILE + j * width) * 4], &tile);
+		}
+	}
+
+	glGenTextures(1, &renderer->tile_texture);
+	glBindTexture(GL_TEXTURE_2D, renderer->tile_texture);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glTexImage2D(
+			GL_TEXTURE_2D,
+			0,
+			GL_RGBA16I,
+			width, world->height,
+			0,
+			GL_RGBA_INTEGER,
+			GL_SHORT,
+			texels
+			);
+
+	/* Texturas inteiras não podem ser filtradas */
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Memory_EndScope(&scope);
+
+	/* O perfil core exige um VAO mesmo sem atributos */
+	glGenVertexArrays(1, &renderer->vao);
+
+	if(!Shader_LoadFiles(&renderer->shader, stack, "res/shaders/tiles.vs", "res/shaders/chunk.fs")) {
+		TileRenderer_Destroy(renderer);
+		return false;
+	}
+
+	return TileRenderer_SetShapes(renderer, world);
+}
+
+void TileRenderer_UpdateTile(TileRenderer *renderer, const World *world, int i, int j) {
+	int16_t texels[TILE_RENDERER_TEXELS_PER_TILE * 4];
+	Tile tile;
+
+	if(!World_GetTile(world, i, j, &tile))
+		return;
+
+	TileRenderer_PackTile(texels, &tile);
+
+	glBindTexture(GL_TEXTURE_2D, renderer->tile_texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glTexSubImage2D(
+			GL_TEXTURE_2D,
+			0,
+			i * TILE_RENDERER_TEXELS_PER_TILE, j,
+			TILE_RENDERER_TEXELS_PER_TILE, 1,
+			GL_RGBA_INTEGER,
+			GL_SHORT,
+			texels
+			);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TileRenderer_Render(const TileRenderer *renderer, const World *world, const Mat4 *view, const Mat4 *projection) {
+	const Shader *shader = &renderer->shader;
+	Mat4 model;
+
+	Mat4_Identity(&model);
+	Shader_SetUniformMat4(shader, "model", &model);
+	Shader_SetUniformMat4(shader, "view", view);
+	Shader_SetUniformMat4(shader, "projection", projection);
+
+	Shader_SetUniform3f(shader, "ambient_light", world->ambient_light.x, world->ambient_light.y, world->ambient_light.z);
+
+	TextureArray_Use(&world->tile_textures, 0);
+	Shader_SetUniform1i(shader, "tex_array", 0);
+
+	glActiveTexture(GL_TEXTURE0 + TILE_RENDERER_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, renderer->tile_texture);
+	Shader_SetUniform1i(shader, "tile_data", TILE_RENDERER_TEXTURE_UNIT);
+
+	Shader_Use(shader);
+	glBindVertexArray(renderer->vao);
+
+	/* Uma instância por tile; as faces que o tile não tem viram
+	 * triângulos fora da tela */
+	glDrawArraysInstanced(GL_TRIANGLES, 0, TILE_RENDERER_VERTICES_PER_TILE, world->width * world->height);
+
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void TileRenderer_Destroy(TileRenderer *renderer) {
+	if(renderer->tile_texture != 0)
+		glDeleteTextures(1, &renderer->tile_texture);
+
+	if(renderer->vao != 0)
+		glDeleteVertexArrays(1, &renderer->vao);
+
+	if(renderer->shader.id != 0)
+		Shader_Destroy(&renderer->shader);
+
+	renderer->tile_texture = 0;
+	renderer->vao = 0;
+}
+
+static void TileRenderer_PackTile(int16_t *texels, const Tile *tile) {
+	texels[0] = (int16_t) lroundf(tile->bot_height * PACKED_VERTEX_SCALE);
+	texels[1] = (int16_t) lroundf(tile->top_height * PACKED_VERTEX_SCALE);
+	texels[2] = (int16_t) tile->wall_type;
+	texels[3] = (int16_t) tile->wall_texture;
+
+	texels[4] = (int16_t) tile->bot_texture;
+	texels[5] = (int16_t) tile->top_texture;
+	texels[6] = (int16_t) tile->bot_window_texture;
+	texels[7] = (int16_t) tile->top_window_texture;
+}
+
+static bool TileRenderer_SetShapes(const TileRenderer *renderer, const World *world) {
+	const WallShape *shape;
+	char name[32];
+	int diagonal;
+
+	/* Para as diagonais, o bit 2 diz se a face vai de (1, 0) a (0, 1).
+	 * Blocos usam -1. */
+	for(int i = 0; i < WALLTYPE_NUMTYPES; i++) {
+		shape = &wall_shapes[i];
+		diagonal = -1;
+
+		if(shape->kind == WALLSHAPE_DIAGONAL)
+			diagonal = shape->corner | (shape->down_to_top ? 4 : 0);
+
+		snprintf(name, sizeof(name), "wall_boxes[%d]", i);
+		Shader_SetUniform4f(&renderer->shader, name, shape->offset_x, shape->offset_z, shape->size_x, shape->size_z);
+
+		snprintf(name, sizeof(name), "wall_diagonals[%d]", i);
+		Shader_SetUniform1i(&renderer->shader, name, diagonal);
+	}
+
+	Shader_SetUniform1i(&renderer->shader, "world_width", world->width);
+
+	return Shader_SetUniform1i(&renderer->shader, "world_height", world->height);
+}
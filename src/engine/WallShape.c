@@ -0,0 +1,29 @@
+#include "engine/WallShape.h"
+
+/* Derivados do canto, como faziam os cases antigos de colisão: a face
+ * diagonal sai de (1, 0) quando o canto ocupado é (0, 0) ou (1, 1) */
+#define WALLSHAPE_DOWN_TO_TOP(corner) ( (corner) == 0 || (corner) == 3 )
+#define WALLSHAPE_NORMAL_X(corner) ( (corner) & 1 ? -1.0f : 1.0f )
+#define WALLSHAPE_NORMAL_Z(corner) ( (corner) & 2 ? -1.0f : 1.0f )
+
+#define WALLSHAPE_ENTRY(type, shape_kind, ox, oz, sx, sz, c) \
+	[type] = { \
+		.kind = shape_kind, \
+		.offset_x = ox, .offset_z = oz, \
+		.size_x = sx, .size_z = sz, \
+		.corner = c, \
+		.down_to_top = WALLSHAPE_DOWN_TO_TOP(c), \
+		.plane = { WALLSHAPE_DOWN_TO_TOP(c) ? 1.0f : 0.0f, 0.0f, 0.0f }, \
+		.normal = { WALLSHAPE_NORMAL_X(c), 0.0f, WALLSHAPE_NORMAL_Z(c) }, \
+	},
+
+const WallShape wall_shapes[WALLTYPE_NUMTYPES] = {
+	WALLTYPE_TABLE(WALLSHAPE_ENTRY)
+};
+
+const WallShape *WallShape_Get(WallType wall_type) {
+	if((unsigned int) wall_type >= WALLTYPE_NUMTYPES)
+		return &wall_shapes[WALLTYPE_BLOCK];
+
+	return &wall_shapes[wall_type];
+}
@@ -1,43 +1,304 @@
 #include "engine/World.h"
 #include <stddef.h>
+#include <string.h>
+#include <stdio.h>
 
 #include <math.h>
 
 #include "base/Box.h"
+#include "engine/WallShape.h"
 
 #define MIN_HEIGHT -999.0f
 #define MAX_HEIGHT 999.0f
 
-static bool World_CheckCollisionFloor(const World *world, int i, int j, const Vec3 *position, const Vec3 *size);
-static bool World_CheckCollisionCeiling(const World *world, int i, int j, const Vec3 *position, const Vec3 *size);
-static bool World_CheckCollisionWall(const World *world, int i, int j, const Vec3 *position, const Vec3 *size);
+/* Luz que todo vértice recebe antes das luzes estáticas e da oclusão */
+#define WORLD_DEFAULT_AMBIENT_LIGHT 0.6f
+
+/* Para voltar a um LOD mais detalhado o chunk precisa chegar essa
+ * distância mais perto do que a que o fez trocar, senão o LOD fica
+ * alternando quando a câmera está parada na fronteira */
+#define WORLD_LOD_HYSTERESIS 8.0f
+
+/* Distância em tiles a partir da qual cada LOD é usado */
+static const float world_lod_distances[CHUNK_NUM_LODS] = { 0.0f, 96.0f, 192.0f };
+
+typedef char packed_tile_size_check[sizeof(PackedTile) == 10 ? 1 : -1];
+
+/* Chunk_GetTileIndex precisa de uma potência de 2 até 256 */
+typedef char chunk_size_check[(CHUNK_SIZE & (CHUNK_SIZE - 1)) == 0 && CHUNK_SIZE <= 256 ? 1 : -1];
+
+/* World_EditTile supõe que o alcance não passa do chunk vizinho */
+typedef char chunk_reach_check[CHUNK_BUILD_REACH >= 1 && CHUNK_BUILD_REACH < CHUNK_SIZE ? 1 : -1];
+
+/* Coluna sem espaço entre chão e teto, para o que está fora do mundo */
+static const PackedTile world_outside_tile = { .wall_type = WALLTYPE_BLOCK };
+
+static bool World_PackHeight(int16_t *packed, float height);
+static bool World_PackTile(PackedTile *packed, const Tile *tile);
+static int Chunk_GetApronIndex(int i, int j);
+static int World_HashChunkIndex(const World *world, int index);
+static Chunk * World_AllocChunk(World *world, int index, const PackedTile *tiles);
+static void World_SpreadBorder(World *world, const Chunk *chunk, const PackedTile *packed);
+static void World_MarkChunksDirty(World *world, const Chunk *chunk);
+static void World_UpdateAprons(World *world, int i, int j, const PackedTile *packed);
+static bool World_CheckCollisionFloor(const Tile *tile, int i, int j, const Vec3 *position, const Vec3 *size);
+static bool World_CheckCollisionCeiling(const Tile *tile, int i, int j, const Vec3 *position, const Vec3 *size);
+static bool World_CheckCollisionWall(const Tile *tile, int i, int j, const Vec3 *position, const Vec3 *size);
+static void World_MarkDirty(World *world, int i, int j);
+static float World_GetChunkDistance(const Chunk *chunk, const Vec3 *camera);
+static int World_SelectLod(const Chunk *chunk, float distance);
+
+bool World_Create(World *world, Memory *memory, int width, int height, int max_chunks) {
+	if(width <= 0 || height <= 0 || max_chunks <= 0)
+		return false;
+
+	world->chunks_x = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	world->chunks_y = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	world->width = world->chunks_x * CHUNK_SIZE;
+	world->height = world->chunks_y * CHUNK_SIZE;
+
+	/* Com no máximo metade do mapa ocupada as buscas são curtas */
+	world->chunk_map_size = 1;
+
+	while(world->chunk_map_size < 2 * max_chunks)
+		world->chunk_map_size *= 2;
+
+	world->max_chunks = max_chunks;
+	world->chunks = Memory_AllocTagged(memory, max_chunks * sizeof(Chunk *), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_WORLD);
+	world->chunk_map = Memory_AllocTagged(memory, world->chunk_map_size * sizeof(Chunk *), MEMORY_DEFAULT_ALIGNMENT, MEMTAG_WORLD);
+
+	if(world->chunks == NULL || world->chunk_map == NULL)
+		return false;
+
+	if(!Pool_Create(&world->chunk_pool, memory, sizeof(Chunk), max_chunks))
+		return false;
+
+	world->num_chunks = 0;
+
+	for(int i = 0; i < world->chunk_map_size; i++)
+		world->chunk_map[i] = NULL;
+
+	world->last_revision = 0;
+
+	world->num_lights = 0;
+	world->ambient_light = (Vec3) {
+		WORLD_DEFAULT_AMBIENT_LIGHT,
+		WORLD_DEFAULT_AMBIENT_LIGHT,
+		WORLD_DEFAULT_AMBIENT_LIGHT
+	};
+
+	return true;
+}
+
+void World_Clear(World *world) {
+	Chunk *chunk;
+
+	for(int i = 0; i < world->num_chunks; i++) {
+		chunk = world->chunks[i];
+
+		for(int lod = 0; lod < CHUNK_NUM_LODS; lod++) {
+			if(chunk->lods[lod].vao != 0)
+				Mesh_Destroy(&chunk->lods[lod]);
+		}
+	}
+
+	for(int i = 0; i < world->chunk_map_size; i++)
+		world->chunk_map[i] = NULL;
+
+	Pool_Reset(&world->chunk_pool);
+	world->num_chunks = 0;
+	world->num_lights = 0;
+}
 
-const Tile * World_GetTile(const World *world, int i, int j) {
+Chunk * World_GetChunk(const World *world, int index) {
+	Chunk *chunk;
+
+	for(int k = World_HashChunkIndex(world, index);; k = (k + 1) & (world->chunk_map_size - 1)) {
+		chunk = world->chunk_map[k];
+
+		if(chunk == NULL || chunk->index == index)
+			return chunk;
+	}
+}
+
+bool World_GetTile(const World *world, int i, int j, Tile *tile) {
 	const Chunk *chunk;
 
-	if(i < 0 || j < 0 || i >= WORLD_SIZE || j >= WORLD_SIZE)
-		return NULL;
+	if(i < 0 || j < 0 || i >= world->width || j >= world->height)
+		return false;
+
+	chunk = World_GetChunk(world, World_GetChunkIndex(world, i, j));
+
+	if(chunk == NULL)
+		return false;
 
-	chunk = &world->chunks[World_GetChunkIndex(i, j)];
+	World_UnpackTile(tile, &chunk->tiles[Chunk_GetTileIndex(i, j)]);
+
+	return true;
+}
+
+const PackedTile * Chunk_GetTile(const Chunk *chunk, int i, int j) {
+	if((unsigned int) i < CHUNK_SIZE && (unsigned int) j < CHUNK_SIZE)
+		return &chunk->tiles[Chunk_GetTileIndex(i, j)];
+
+	return &chunk->apron[Chunk_GetApronIndex(i, j)];
+}
+
+const PackedTile * World_GetPackedTile(const World *world, int i, int j) {
+	const Chunk *chunk;
+
+	if(i < 0 || j < 0 || i >= world->width || j >= world->height)
+		return &world_outside_tile;
+
+	chunk = World_GetChunk(world, World_GetChunkIndex(world, i, j));
+
+	if(chunk == NULL)
+		return &world_outside_tile;
 
 	return &chunk->tiles[Chunk_GetTileIndex(i, j)];
 }
 
+void World_UnpackTile(Tile *tile, const PackedTile *packed) {
+	tile->bot_height = (float) packed->bot_height / TILE_HEIGHT_SCALE;
+	tile->bot_window_texture = packed->bot_window_texture;
+	tile->bot_texture = packed->bot_texture;
+
+	tile->top_height = (float) packed->top_height / TILE_HEIGHT_SCALE;
+	tile->top_window_texture = packed->top_window_texture;
+	tile->top_texture = packed->top_texture;
+
+	tile->wall_texture = packed->wall_texture;
+	tile->wall_type = packed->wall_type;
+}
+
 bool World_EditTile(World *world, int i, int j, const Tile *tile) {
+	PackedTile packed;
 	Chunk *chunk;
 
-	if(i < 0 || j < 0 || i >= WORLD_SIZE || j >= WORLD_SIZE)
+	if(i < 0 || j < 0 || i >= world->width || j >= world->height)
+		return false;
+
+	if(!World_PackTile(&packed, tile))
+		return false;
+
+	chunk = World_GetChunk(world, World_GetChunkIndex(world, i, j));
+
+	if(chunk == NULL)
+		chunk = World_AllocChunk(world, World_GetChunkIndex(world, i, j), NULL);
+
+	if(chunk == NULL)
+		return false;
+
+	chunk->tiles[Chunk_GetTileIndex(i, j)] = packed;
+
+	World_UpdateAprons(world, i, j, &packed);
+
+	/* O builder lê até CHUNK_BUILD_REACH tiles além da borda, inclusive
+	 * na diagonal. Como o alcance é menor que um chunk, os cantos e os
+	 * meios do quadrado em volta do tile caem em todos os chunks que ele
+	 * toca. */
+	for(int dj = -CHUNK_BUILD_REACH; dj <= CHUNK_BUILD_REACH; dj += CHUNK_BUILD_REACH) {
+		for(int di = -CHUNK_BUILD_REACH; di <= CHUNK_BUILD_REACH; di += CHUNK_BUILD_REACH)
+			World_MarkDirty(world, i + di, j + dj);
+	}
+
+	return true;
+}
+
+Chunk * World_LoadChunk(World *world, int index, const PackedTile *tiles) {
+	Chunk *chunk = World_GetChunk(world, index);
+
+	if(chunk == NULL) {
+		chunk = World_AllocChunk(world, index, tiles);
+
+		if(chunk == NULL)
+			return NULL;
+	}
+	else {
+		memcpy(chunk->tiles, tiles, sizeof(chunk->tiles));
+		World_SpreadBorder(world, chunk, NULL);
+	}
+
+	/* A borda dos vizinhos deixou de ser sólida */
+	World_MarkChunksDirty(world, chunk);
+
+	return chunk;
+}
+
+void World_FreeChunk(World *world, int index) {
+	Chunk *chunk = World_GetChunk(world, index);
+	int mask = world->chunk_map_size - 1;
+	int k, next, home;
+
+	if(chunk == NULL)
+		return;
+
+	for(int lod = 0; lod < CHUNK_NUM_LODS; lod++) {
+		if(chunk->lods[lod].vao != 0)
+			Mesh_Destroy(&chunk->lods[lod]);
+	}
+
+	World_SpreadBorder(world, chunk, &world_outside_tile);
+	World_MarkChunksDirty(world, chunk);
+
+	/* Remoção com deslocamento para trás: os chunks seguintes da mesma
+	 * sequência de sondagem voltam para o buraco, sem deixar lápides */
+	for(k = World_HashChunkIndex(world, index); world->chunk_map[k] != chunk; k = (k + 1) & mask);
+
+	world->chunk_map[k] = NULL;
+
+	for(next = (k + 1) & mask; world->chunk_map[next] != NULL; next = (next + 1) & mask) {
+		home = World_HashChunkIndex(world, world->chunk_map[next]->index);
+
+		if(((next - home) & mask) >= ((next - k) & mask)) {
+			world->chunk_map[k] = world->chunk_map[next];
+			world->chunk_map[next] = NULL;
+			k = next;
+		}
+	}
+
+	world->chunks[chunk->slot] = world->chunks[--world->num_chunks];
+	world->chunks[chunk->slot]->slot = chunk->slot;
+
+	Pool_Free(&world->chunk_pool, chunk);
+}
+
+bool World_AddLight(World *world, const Vec3 *position, const Vec3 *color, float radius) {
+	WorldLight *light;
+
+	if(world->num_lights >= WORLD_MAX_LIGHTS || radius <= 0.0f || radius > WORLD_MAX_LIGHT_RADIUS)
 		return false;
 
-	chunk = &world->chunks[World_GetChunkIndex(i, j)];
+	light = &world->lights[world->num_lights++];
+
+	light->position = *position;
+	light->color = *color;
+	light->radius = radius;
 
-	chunk->tiles[Chunk_GetTileIndex(i, j)] = *tile;
+	for(int i = 0; i < world->num_chunks; i++) {
+		if(World_LightReachesChunk(light, world->chunks[i]))
+			world->chunks[i]->dirty = true;
+	}
 
 	return true;
 }
 
-void World_Render(const World *world, const Mat4 *view, const Mat4 *projection) {
+bool World_LightReachesChunk(const WorldLight *light, const Chunk *chunk) {
+	return World_GetChunkDistance(chunk, &light->position) < light->radius;
+}
+
+void World_Render(World *world, const Mat4 *view, const Mat4 *projection) {
+	const float *arr = view->arr;
+	Chunk *chunk;
 	Mat4 model;
+	Vec3 camera;
+	int lod;
+
+	/* A view é uma rotação seguida de translação, então a câmera fica
+	 * em -R^T t */
+	camera.x = -(arr[0] * arr[3] + arr[4] * arr[7] + arr[8] * arr[11]);
+	camera.y = -(arr[1] * arr[3] + arr[5] * arr[7] + arr[9] * arr[11]);
+	camera.z = -(arr[2] * arr[3] + arr[6] * arr[7] + arr[10] * arr[11]);
 
 	Mat4_Identity(&model);
 	Shader_SetUniformMat4(&world->shader, "model", &model);
@@ -47,9 +308,24 @@ void World_Render(const World *world, const Mat4 *view, const Mat4 *projection)
 	TextureArray_Use(&world->tile_textures, 0);
 	Shader_SetUniform1i(&world->shader, "tex_array", 0);
 	
-	for(int i = 0; i < NUM_CHUNKS * NUM_CHUNKS; i++) {
+	for(int i = 0; i < world->num_chunks; i++) {
+		chunk = world->chunks[i];
+		chunk->lod = World_SelectLod(chunk, World_GetChunkDistance(chunk, &camera));
+
+		/* Enquanto o LOD escolhido não foi construído, usa o mais próximo
+		 * dele que já existe */
+		for(lod = chunk->lod; lod > 0 && chunk->lods[lod].vao == 0; lod--);
+
+		Shader_SetUniform3f(
+				&world->shader,
+				"chunk_origin",
+				(float) chunk->x,
+				0.0f,
+				(float) chunk->y
+				);
+
 		Mesh_Render(
-				&world->chunks[i].mesh,
+				&chunk->lods[lod],
 				&world->shader
 				);
 	}
@@ -62,15 +338,38 @@ bool World_CheckCollisionBox(const World *world, const Vec3 *position, const Vec
 	int max_x = min_x + (int) ceilf(size->x);
 	int max_z = min_z + (int) ceilf(size->z);
 
+	const Chunk *chunk = NULL;
+	int chunk_x = 0, chunk_z = 0;
+	Tile tile;
+
+	/* Quase sempre a caixa cabe no chunk mais a borda copiada, e os
+	 * tiles saem direto dele */
+	if(min_x >= 0 && min_z >= 0 && min_x < world->width && min_z < world->height) {
+		chunk_x = min_x / CHUNK_SIZE * CHUNK_SIZE;
+		chunk_z = min_z / CHUNK_SIZE * CHUNK_SIZE;
+
+		if(max_x - chunk_x <= CHUNK_SIZE && max_z - chunk_z <= CHUNK_SIZE)
+			chunk = World_GetChunk(world, World_GetChunkIndex(world, min_x, min_z));
+	}
+
 	for(int i = min_x; i <= max_x; i++) {
 		for(int j = min_z; j <= max_z; j++) {
-			if(World_CheckCollisionFloor(world, i, j, position, size))
+			/* Fora do mundo e chunks que faltam são sólidos */
+			if(i < 0 || j < 0 || i >= world->width || j >= world->height)
+				return true;
+
+			if(chunk != NULL)
+				World_UnpackTile(&tile, Chunk_GetTile(chunk, i - chunk_x, j - chunk_z));
+			else if(!World_GetTile(world, i, j, &tile))
 				return true;
 
-			if(World_CheckCollisionCeiling(world, i, j, position, size))
+			if(World_CheckCollisionFloor(&tile, i, j, position, size))
 				return true;
 
-			if(World_CheckCollisionWall(world, i, j, position, size))
+			if(World_CheckCollisionCeiling(&tile, i, j, position, size))
+				return true;
+
+			if(World_CheckCollisionWall(&tile, i, j, position, size))
 				return true;
 		}
 	}
@@ -78,14 +377,190 @@ bool World_CheckCollisionBox(const World *world, const Vec3 *position, const Vec
 	return false;
 }
 
-static bool World_CheckCollisionFloor(const World *world, int i, int j, const Vec3 *position, const Vec3 *size) {
-	const Tile *tile;
-	Vec3 tile_position, tile_size;
+static bool World_PackHeight(int16_t *packed, float height) {
+	float scaled = roundf(height * TILE_HEIGHT_SCALE);
+
+	if(scaled < INT16_MIN || scaled > INT16_MAX)
+		return false;
+
+	*packed = (int16_t) scaled;
+
+	return true;
+}
+
+static bool World_PackTile(PackedTile *packed, const Tile *tile) {
+	const int textures[] = {
+		tile->bot_texture, tile->bot_window_texture,
+		tile->top_texture, tile->top_window_texture,
+		tile->wall_texture
+	};
+
+	for(size_t k = 0; k < sizeof(textures) / sizeof(textures[0]); k++) {
+		if(textures[k] < 0 || textures[k] > UINT8_MAX)
+			return false;
+	}
+
+	if((unsigned int) tile->wall_type >= WALLTYPE_NUMTYPES)
+		return false;
+
+	if(!World_PackHeight(&packed->bot_height, tile->bot_height))
+		return false;
+
+	if(!World_PackHeight(&packed->top_height, tile->top_height))
+		return false;
+
+	packed->bot_texture = tile->bot_texture;
+	packed->bot_window_texture = tile->bot_window_texture;
+	packed->top_texture = tile->top_texture;
+	packed->top_window_texture = tile->top_window_texture;
+	packed->wall_texture = tile->wall_texture;
+	packed->wall_type = tile->wall_type;
+
+	return true;
+}
+
+static int Chunk_GetApronIndex(int i, int j) {
+	/* Linhas de baixo e de cima com os cantos, depois as colunas */
+	if(j < 0)
+		return i + 1;
+
+	if(j >= CHUNK_SIZE)
+		return (CHUNK_SIZE + 2) + i + 1;
+
+	if(i < 0)
+		return 2 * (CHUNK_SIZE + 2) + j;
+
+	return 2 * (CHUNK_SIZE + 2) + CHUNK_SIZE + j;
+}
+
+static int World_HashChunkIndex(const World *world, int index) {
+	uint32_t hash = (uint32_t) index * 0x9e3779b1u;
+
+	return (int) ((hash ^ hash >> 16) & (uint32_t) (world->chunk_map_size - 1));
+}
+
+static Chunk * World_AllocChunk(World *world, int index, const PackedTile *tiles) {
+	Chunk *chunk, *neighbour;
+	int k, x, y;
+
+	chunk = Pool_Alloc(&world->chunk_pool);
+
+	if(chunk == NULL) {
+		fprintf(stderr, "Too many chunks, the limit is %d.\n", world->max_chunks);
+		return NULL;
+	}
+
+	chunk->x = index % world->chunks_x * CHUNK_SIZE;
+	chunk->y = index / world->chunks_x * CHUNK_SIZE;
+	chunk->index = index;
+
+	if(tiles != NULL)
+		memcpy(chunk->tiles, tiles, sizeof(chunk->tiles));
+	else
+		memset(chunk->tiles, 0, sizeof(chunk->tiles));
+
+	for(int lod = 0; lod < CHUNK_NUM_LODS; lod++)
+		chunk->lods[lod] = (Mesh) {0};
+
+	chunk->lod = 0;
+	chunk->dirty = false;
+	chunk->revision = 0;
+
+	/* A borda vem dos vizinhos que já existem; o resto é sólido */
+	for(int j = -1; j <= CHUNK_SIZE; j++) {
+		for(int i = -1; i <= CHUNK_SIZE; i++) {
+			if(i >= 0 && j >= 0 && i < CHUNK_SIZE && j < CHUNK_SIZE)
+				continue;
+
+			x = chunk->x + i;
+			y = chunk->y + j;
+			neighbour = NULL;
+
+			if(x >= 0 && y >= 0 && x < world->width && y < world->height)
+				neighbour = World_GetChunk(world, World_GetChunkIndex(world, x, y));
+
+			if(neighbour != NULL)
+				chunk->apron[Chunk_GetApronIndex(i, j)] = neighbour->tiles[Chunk_GetTileIndex(x, y)];
+			else
+				chunk->apron[Chunk_GetApronIndex(i, j)] = world_outside_tile;
+		}
+	}
+
+	for(k = World_HashChunkIndex(world, index); world->chunk_map[k] != NULL; k = (k + 1) & (world->chunk_map_size - 1));
 
-	tile = World_GetTile(world, i, j);
+	world->chunk_map[k] = chunk;
+	chunk->slot = world->num_chunks;
+	world->chunks[world->num_chunks++] = chunk;
 
-	if(tile == NULL)
-		return true;
+	/* Os vizinhos passam a ver os tiles deste chunk */
+	World_SpreadBorder(world, chunk, NULL);
+
+	return chunk;
+}
+
+static void World_SpreadBorder(World *world, const Chunk *chunk, const PackedTile *packed) {
+	int x, y;
+
+	/* Com packed == NULL copia os próprios tiles da borda do chunk */
+	for(int i = 0; i < CHUNK_SIZE; i++) {
+		for(int side = 0; side < 4; side++) {
+			x = side < 2 ? i : (side == 2 ? 0 : CHUNK_SIZE - 1);
+			y = side < 2 ? (side == 0 ? 0 : CHUNK_SIZE - 1) : i;
+
+			World_UpdateAprons(
+					world,
+					chunk->x + x,
+					chunk->y + y,
+					packed != NULL ? packed : &chunk->tiles[Chunk_GetTileIndex(x, y)]
+					);
+		}
+	}
+}
+
+static void World_MarkChunksDirty(World *world, const Chunk *chunk) {
+	Chunk *neighbour;
+
+	for(int y = chunk->y - CHUNK_SIZE; y <= chunk->y + CHUNK_SIZE; y += CHUNK_SIZE) {
+		for(int x = chunk->x - CHUNK_SIZE; x <= chunk->x + CHUNK_SIZE; x += CHUNK_SIZE) {
+			if(x < 0 || y < 0 || x >= world->width || y >= world->height)
+				continue;
+
+			neighbour = World_GetChunk(world, World_GetChunkIndex(world, x, y));
+
+			if(neighbour != NULL)
+				neighbour->dirty = true;
+		}
+	}
+}
+
+static void World_UpdateAprons(World *world, int i, int j, const PackedTile *packed) {
+	int chunk_x = i / CHUNK_SIZE;
+	int chunk_y = j / CHUNK_SIZE;
+	int local_x, local_y;
+	Chunk *chunk;
+
+	/* Só tiles da borda aparecem na borda copiada de algum vizinho */
+	for(int y = chunk_y - 1; y <= chunk_y + 1; y++) {
+		for(int x = chunk_x - 1; x <= chunk_x + 1; x++) {
+			if(x < 0 || y < 0 || x >= world->chunks_x || y >= world->chunks_y || (x == chunk_x && y == chunk_y))
+				continue;
+
+			local_x = i - x * CHUNK_SIZE;
+			local_y = j - y * CHUNK_SIZE;
+
+			if(local_x < -1 || local_y < -1 || local_x > CHUNK_SIZE || local_y > CHUNK_SIZE)
+				continue;
+
+			chunk = World_GetChunk(world, x + y * world->chunks_x);
+
+			if(chunk != NULL)
+				chunk->apron[Chunk_GetApronIndex(local_x, local_y)] = *packed;
+		}
+	}
+}
+
+static bool World_CheckCollisionFloor(const Tile *tile, int i, int j, const Vec3 *position, const Vec3 *size) {
+	Vec3 tile_position, tile_size;
 
 	tile_size = (Vec3) {1.0f, tile->bot_height - MIN_HEIGHT, 1.0f};
 	tile_position = (Vec3) {i, 0.0f + MIN_HEIGHT, j};
@@ -93,98 +568,67 @@ static bool World_CheckCollisionFloor(const World *world, int i, int j, const Ve
 	return Box_CheckCollision(position, size, &tile_position, &tile_size);
 }
 
-static bool World_CheckCollisionCeiling(const World *world, int i, int j, const Vec3 *position, const Vec3 *size) {
-	const Tile *tile;
+static bool World_CheckCollisionCeiling(const Tile *tile, int i, int j, const Vec3 *position, const Vec3 *size) {
 	Vec3 tile_position, tile_size;
 
-	tile = World_GetTile(world, i, j);
-
-	if(tile == NULL)
-		return true;
-
 	tile_size = (Vec3) {1.0f, MAX_HEIGHT - tile->top_height, 1.0f};
 	tile_position = (Vec3) {i, tile->top_height, j};
 
 	return Box_CheckCollision(position, size, &tile_position, &tile_size);
 }
 
-static bool World_CheckCollisionWall(const World *world, int i, int j, const Vec3 *position, const Vec3 *size) {
-	const Tile *tile;
-	Vec3 tile_position, tile_size, normal;
-
-	tile = World_GetTile(world, i, j);
+static bool World_CheckCollisionWall(const Tile *tile, int i, int j, const Vec3 *position, const Vec3 *size) {
+	const WallShape *shape;
+	Vec3 tile_position, tile_size;
 
-	if(tile == NULL)
-		return true;
+	shape = WallShape_Get(tile->wall_type);
 
-	tile_size = (Vec3) {1.0f, tile->top_height - tile->bot_height, 1.0f};
-	tile_position = (Vec3) {i, tile->bot_height, j};
+	if(shape->kind == WALLSHAPE_EMPTY)
+		return false;
 
-	switch(tile->wall_type) {
-		case WALLTYPE_NONE:
-			return false;
-			break;
-
-		case WALLTYPE_BLOCK:
-			return Box_CheckCollision(position, size, &tile_position, &tile_size);
-			break;
-
-		case WALLTYPE_HALFBLOCK_DOWN:
-			tile_size.z = 0.5f;
-			return Box_CheckCollision(position, size, &tile_position, &tile_size);
-			break;
-
-		case WALLTYPE_HALFBLOCK_UP:
-			tile_position.z += 0.5f;
-			tile_size.z = 0.5f;
-			return Box_CheckCollision(position, size, &tile_position, &tile_size);
-			break;
-
-		case WALLTYPE_HALFBLOCK_LEFT:
-			tile_size.x = 0.5f;
-			return Box_CheckCollision(position, size, &tile_position, &tile_size);
-			break;
-
-		case WALLTYPE_HALFBLOCK_RIGHT:
-			tile_position.x += 0.5f;
-			tile_size.x = 0.5f;
-			return Box_CheckCollision(position, size, &tile_position, &tile_size);
-			break;
-
-		case WALLTYPE_HALFBLOCK_MIDDLE:
-			tile_position.x += 0.25f;
-			tile_position.z += 0.25f;
-			tile_size.x = 0.5f;
-			tile_size.z = 0.5f;
-			return Box_CheckCollision(position, size, &tile_position, &tile_size);
-			break;
-
-		case WALLTYPE_DIAGONAL_DOWNLEFT:
-			tile_position.x += 1.0f;
-			normal = (Vec3) {1.0f, 0.0f, 1.0f};
-			return Box_CheckCollisionSemiSpace(position, size, &tile_position, &normal);
-			break;
-
-		case WALLTYPE_DIAGONAL_DOWNRIGHT:
-			normal = (Vec3) {-1.0f, 0.0f, 1.0f};
-			return Box_CheckCollisionSemiSpace(position, size, &tile_position, &normal);
-			break;
-
-		case WALLTYPE_DIAGONAL_UPLEFT:
-			normal = (Vec3) {1.0f, 0.0f, -1.0f};
-			return Box_CheckCollisionSemiSpace(position, size, &tile_position, &normal);
-			break;
-
-		case WALLTYPE_DIAGONAL_UPRIGHT:
-			tile_position.x += 1.0f;
-			normal = (Vec3) {-1.0f, 0.0f, -1.0f};
-			return Box_CheckCollisionSemiSpace(position, size, &tile_position, &normal);
-			break;
-
-		default:
-			return true;
-			break;
+	if(shape->kind == WALLSHAPE_DIAGONAL) {
+		tile_position = (Vec3) {i + shape->plane.x, tile->bot_height, j + shape->plane.z};
+		return Box_CheckCollisionSemiSpace(position, size, &tile_position, &shape->normal);
 	}
 
-	return false;
+	tile_size = (Vec3) {shape->size_x, tile->top_height - tile->bot_height, shape->size_z};
+	tile_position = (Vec3) {i + shape->offset_x, tile->bot_height, j + shape->offset_z};
+
+	return Box_CheckCollision(position, size, &tile_position, &tile_size);
+}
+
+static void World_MarkDirty(World *world, int i, int j) {
+	Chunk *chunk;
+
+	if(i < 0 || j < 0 || i >= world->width || j >= world->height)
+		return;
+
+	chunk = World_GetChunk(world, World_GetChunkIndex(world, i, j));
+
+	if(chunk != NULL)
+		chunk->dirty = true;
+}
+
+static float World_GetChunkDistance(const Chunk *chunk, const Vec3 *camera) {
+	float min_x = (float) chunk->x;
+	float min_z = (float) chunk->y;
+	float dx, dz;
+
+	/* Distância no plano xz até o retângulo do chunk */
+	dx = fmaxf(fmaxf(min_x - camera->x, camera->x - min_x - CHUNK_SIZE), 0.0f);
+	dz = fmaxf(fmaxf(min_z - camera->z, camera->z - min_z - CHUNK_SIZE), 0.0f);
+
+	return sqrtf(dx * dx + dz * dz);
+}
+
+static int World_SelectLod(const Chunk *chunk, float distance) {
+	int lod = chunk->lod;
+
+	while(lod + 1 < CHUNK_NUM_LODS && distance > world_lod_distances[lod + 1] + WORLD_LOD_HYSTERESIS)
+		lod++;
+
+	while(lod > 0 && distance < world_lod_distances[lod] - WORLD_LOD_HYSTERESIS)
+		lod--;
+
+	return lod;
 }
@@ -16,8 +16,9 @@
 
 #include "game/Player.h"
 
-#define BASE_MEMORY ( 16 * 1024 * 1024 )
-#define STACK_MEMORY ( 8 * 1024 * 1024 )
+/* Apenas reservados, as páginas são usadas sob demanda */
+#define BASE_MEMORY ( (size_t) 1024 * 1024 * 1024 )
+#define STACK_MEMORY ( (size_t) 256 * 1024 * 1024 )
 
 int main(int argc, char **argv) {
 	(void) argc;
@@ -27,20 +28,39 @@ int main(int argc, char **argv) {
 	Context *context;
 	Game *game;
 
-	memory = Memory_Create(malloc(BASE_MEMORY), BASE_MEMORY);
-	stack = Memory_Create(malloc(STACK_MEMORY), STACK_MEMORY);
+	if(!Memory_Reserve(&memory, BASE_MEMORY, MEMORY_HUGE_PAGES_TRANSPARENT))
+		return 1;
+
+	if(!Memory_Reserve(&stack, STACK_MEMORY, MEMORY_HUGE_PAGES_TRANSPARENT))
+		return 1;
 
 	context = Context_Create("oi", 1280, 720, &memory, &stack);
 	game = Game_Create(context);
 
-	Player_Create(Game_AddEntity(game));
+	if(game == NULL)
+		return 1;
+
+	game->player = Game_AddEntity(game);
+	Player_Create(game->player);
+
+	/* Sem spawn no nível o jogador fica na posição do Player_Create */
+	for(int i = 0; i < game->num_spawns; i++) {
+		if(game->spawns[i].type == LEVEL_SPAWN_PLAYER) {
+			game->player->position = game->spawns[i].position;
+			game->player->angle.y = game->spawns[i].angle;
+			break;
+		}
+	}
 
 	Game_Run(game);
+	Game_Destroy(game);
 
-	printf("%lu KB\n", memory.top / 1024 );
+	Memory_PrintReport(&memory, "memory");
+	Memory_PrintReport(&stack, "stack");
 
 	Context_Destroy(context);
-	free(memory.block);
+	Memory_Release(&memory);
+	Memory_Release(&stack);
 
 	return 0;
 }
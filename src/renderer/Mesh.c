@@ -1,5 +1,14 @@
 #include <renderer/Mesh.h>
 #include <glad/glad.h>
+#include <math.h>
+
+/* O shader dos chunks depende desse layout */
+typedef char packed_vertex_size_check[sizeof(PackedVertex) == 16 ? 1 : -1];
+
+static unsigned int quad_ebo = 0;
+
+static bool Mesh_CreateQuadIndices(void);
+static void Mesh_CreateBuffers(Mesh *mesh, const void *vertices, size_t vertices_size, const unsigned int *indices, size_t num_indices);
 
 bool Vertex_CreateSimple(Vertex *vertex, float x, float y, float z, float u, float v){
 	if(vertex == NULL)
@@ -15,20 +24,26 @@ bool Vertex_CreateSimple(Vertex *vertex, float x, float y, float z, float u, flo
 	return true;
 }
 
-bool Mesh_Create(Mesh *mesh, const Vertex *vertices, size_t num_vertices, const unsigned int *indices, size_t num_indices){
-	mesh->num_indices = num_indices;
+bool PackedVertex_Create(PackedVertex *vertex, float x, float y, float z, float u, float v, int layer_index){
+	if(vertex == NULL)
+		return false;
 
-	glGenVertexArrays(1, &mesh->vao);
-	glGenBuffers(1, &mesh->vbo);
-	glGenBuffers(1, &mesh->ebo);
+	vertex->x = (int16_t) lroundf(x * PACKED_VERTEX_SCALE);
+	vertex->y = (int16_t) lroundf(y * PACKED_VERTEX_SCALE);
+	vertex->z = (int16_t) lroundf(z * PACKED_VERTEX_SCALE);
+	vertex->u = (int16_t) lroundf(u * PACKED_VERTEX_SCALE);
+	vertex->v = (int16_t) lroundf(v * PACKED_VERTEX_SCALE);
+	vertex->normal = PACKED_NORMAL_NONE;
+	vertex->layer_index = (uint8_t) layer_index;
 
-	glBindVertexArray(mesh->vao);
+	for(int i = 0; i < 4; i++)
+		vertex->color[i] = 0xff;
 
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-	glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	return true;
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+bool Mesh_Create(Mesh *mesh, const Vertex *vertices, size_t num_vertices, const unsigned int *indices, size_t num_indices){
+	Mesh_CreateBuffers(mesh, vertices, num_vertices * sizeof(Vertex), indices, num_indices);
 
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) 0);
 	glEnableVertexAttribArray(0);
@@ -51,6 +66,63 @@ bool Mesh_Create(Mesh *mesh, const Vertex *vertices, size_t num_vertices, const
 	return true;
 }
 
+bool Mesh_CreatePacked(Mesh *mesh, const PackedVertex *vertices, size_t num_vertices){
+	if(!Mesh_CreateQuadIndices())
+		return false;
+
+	mesh->num_indices = 0;
+	mesh->num_quads = num_vertices / 4;
+	mesh->ebo = 0;
+
+	glGenVertexArrays(1, &mesh->vao);
+	glGenBuffers(1, &mesh->vbo);
+
+	glBindVertexArray(mesh->vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof(PackedVertex), vertices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_ebo);
+
+	glVertexAttribIPointer(0, 3, GL_SHORT, sizeof(PackedVertex), (void *) offsetof(PackedVertex, x));
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribIPointer(1, 2, GL_SHORT, sizeof(PackedVertex), (void *) offsetof(PackedVertex, u));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, sizeof(PackedVertex), (void *) offsetof(PackedVertex, normal));
+	glEnableVertexAttribArray(2);
+
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex), (void *) offsetof(PackedVertex, color));
+	glEnableVertexAttribArray(3);
+
+	glVertexAttribIPointer(4, 1, GL_UNSIGNED_BYTE, sizeof(PackedVertex), (void *) offsetof(PackedVertex, layer_index));
+	glEnableVertexAttribArray(4);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	return true;
+}
+
+bool Mesh_UpdatePacked(Mesh *mesh, const PackedVertex *vertices, size_t num_vertices){
+	if(mesh->vao == 0)
+		return Mesh_CreatePacked(mesh, vertices, num_vertices);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+
+	/* Orphaning: o driver dá um armazenamento novo ao buffer e os desenhos
+	 * ainda na fila continuam lendo o antigo, sem sincronizar com a GPU */
+	glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof(PackedVertex), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, num_vertices * sizeof(PackedVertex), vertices);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mesh->num_quads = num_vertices / 4;
+
+	return true;
+}
+
 bool Mesh_BuildUnitTetrahedron(Mesh *mesh){
 	Vertex vertices[4];
 
@@ -78,7 +150,21 @@ bool Mesh_Render(const Mesh *mesh, const Shader *shader){
 	Shader_Use(shader);
 
 	glBindVertexArray(mesh->vao);
-	glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, 0);
+
+	if(mesh->num_quads == 0) {
+		glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, 0);
+	}
+	else {
+		for(unsigned int i = 0; i < mesh->num_quads; i += MESH_QUADS_PER_BATCH) {
+			unsigned int num_quads = mesh->num_quads - i;
+
+			if(num_quads > MESH_QUADS_PER_BATCH)
+				num_quads = MESH_QUADS_PER_BATCH;
+
+			glDrawElementsBaseVertex(GL_TRIANGLES, num_quads * 6, GL_UNSIGNED_SHORT, 0, i * 4);
+		}
+	}
+
 	glBindVertexArray(0);
 
 	return true;
@@ -86,8 +172,74 @@ bool Mesh_Render(const Mesh *mesh, const Shader *shader){
 
 bool Mesh_Destroy(const Mesh *mesh){
 	glDeleteBuffers(1, &mesh->vbo);
-	glDeleteBuffers(1, &mesh->ebo);
+
+	/* O index buffer dos quads é compartilhado */
+	if(mesh->num_quads == 0)
+		glDeleteBuffers(1, &mesh->ebo);
 	glDeleteVertexArrays(1, &mesh->vao);
 
 	return true;
 }
+
+static bool Mesh_CreateQuadIndices(void){
+	uint16_t *indices;
+
+	if(quad_ebo != 0)
+		return true;
+
+	glGenBuffers(1, &quad_ebo);
+
+	if(quad_ebo == 0)
+		return false;
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, MESH_QUADS_PER_BATCH * 6 * sizeof(uint16_t), NULL, GL_STATIC_DRAW);
+
+	indices = glMapBufferRange(
+			GL_ELEMENT_ARRAY_BUFFER,
+			0,
+			MESH_QUADS_PER_BATCH * 6 * sizeof(uint16_t),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+			);
+
+	if(indices == NULL) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glDeleteBuffers(1, &quad_ebo);
+		quad_ebo = 0;
+		return false;
+	}
+
+	/* Mesma ordem que o Builder usava para os dois triângulos do quad */
+	for(unsigned int i = 0; i < MESH_QUADS_PER_BATCH; i++) {
+		uint16_t base = (uint16_t) (i * 4);
+
+		indices[i * 6 + 0] = base + 1;
+		indices[i * 6 + 1] = base + 2;
+		indices[i * 6 + 2] = base + 0;
+		indices[i * 6 + 3] = base + 1;
+		indices[i * 6 + 4] = base + 2;
+		indices[i * 6 + 5] = base + 3;
+	}
+
+	glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+static void Mesh_CreateBuffers(Mesh *mesh, const void *vertices, size_t vertices_size, const unsigned int *indices, size_t num_indices){
+	mesh->num_indices = num_indices;
+	mesh->num_quads = 0;
+
+	glGenVertexArrays(1, &mesh->vao);
+	glGenBuffers(1, &mesh->vbo);
+	glGenBuffers(1, &mesh->ebo);
+
+	glBindVertexArray(mesh->vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices_size, vertices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+}
@@ -1,4 +1,5 @@
 #include "renderer/Shader.h"
+#include "base/File.h"
 
 #include <glad/glad.h>
 #include <stddef.h>
@@ -7,12 +8,16 @@
 static int Shader_GetLocation(const Shader *shader, const char *name);
 
 bool Shader_Load(Shader *shader, const char *vertex_src, const char *fragment_src) {
+	return Shader_LoadWithLength(shader, vertex_src, -1, fragment_src, -1);
+}
+
+bool Shader_LoadWithLength(Shader *shader, const char *vertex_src, int vertex_length, const char *fragment_src, int fragment_length) {
 	bool loaded = true;
 	unsigned int vertex_shader = 0, fragment_shader = 0;
 
 	{
 		vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex_shader, 1, &vertex_src, NULL);
+		glShaderSource(vertex_shader, 1, &vertex_src, &vertex_length);
 		glCompileShader(vertex_shader);
 
 		int sucess;
@@ -28,7 +33,7 @@ bool Shader_Load(Shader *shader, const char *vertex_src, const char *fragment_sr
 
 	{
 		fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment_shader, 1, &fragment_src, NULL);
+		glShaderSource(fragment_shader, 1, &fragment_src, &fragment_length);
 		glCompileShader(fragment_shader);
 
 		int sucess;
@@ -64,6 +69,39 @@ bool Shader_Load(Shader *shader, const char *vertex_src, const char *fragment_sr
 	return loaded;
 }
 
+bool Shader_LoadFiles(Shader *shader, Memory *stack, const char *vertex_filename, const char *fragment_filename) {
+	FileView vertex_src, fragment_src;
+	MemoryTag old_tag;
+	bool loaded;
+
+	old_tag = Memory_SetTag(stack, MEMTAG_ASSETS);
+
+	if(!File_Open(&vertex_src, stack, vertex_filename, FILE_ACCESS_SEQUENTIAL)) {
+		fprintf(stderr, "Failed to open shader: %s\n", vertex_filename);
+		Memory_SetTag(stack, old_tag);
+		return false;
+	}
+
+	if(!File_Open(&fragment_src, stack, fragment_filename, FILE_ACCESS_SEQUENTIAL)) {
+		fprintf(stderr, "Failed to open shader: %s\n", fragment_filename);
+		File_Release(&vertex_src);
+		Memory_SetTag(stack, old_tag);
+		return false;
+	}
+
+	loaded = Shader_LoadWithLength(
+			shader,
+			vertex_src.data, (int) vertex_src.size,
+			fragment_src.data, (int) fragment_src.size
+			);
+
+	File_Release(&vertex_src);
+	File_Release(&fragment_src);
+	Memory_SetTag(stack, old_tag);
+
+	return loaded;
+}
+
 void Shader_Use(const Shader *shader) {
 	glUseProgram(shader->id);
 }
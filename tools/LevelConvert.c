@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base/Memory.h"
+#include "engine/Level.h"
+#include "engine/World.h"
+
+/* Converte um nível em texto para o formato binário de Level.h. Cada
+ * linha é um comando; '#' começa um comentário:
+ *
+ *   size <largura> <altura>
+ *   tile <c> <chão> <teto> <tex. chão> <tex. teto> <tex. parede> <janela de baixo> <janela de cima> <WALLTYPE_...>
+ *   fill <c> <x0> <z0> <x1> <z1>
+ *   row <x> <z> <c...>
+ *   light <x> <y> <z> <r> <g> <b> <raio>, raio até WORLD_MAX_LIGHT_RADIUS
+ *   spawn <tipo> <x> <y> <z> <ângulo>
+ *
+ * tile dá nome c a um tile; fill preenche o retângulo de x0, z0 até
+ * x1 - 1, z1 - 1 e row escreve um tile por caractere, andando em x.
+ * size precisa vir antes dos comandos que mexem no mundo. */
+
+#define CONVERT_MEMORY ( (size_t) 4 * 1024 * 1024 * 1024 )
+#define CONVERT_MAX_LINE 4096
+#define CONVERT_MAX_SPAWNS 1024
+
+#define CONVERT_WALLTYPE_NAME(type, kind, offset_x, offset_z, size_x, size_z, corner) #type,
+
+static const char *convert_walltype_names[WALLTYPE_NUMTYPES] = {
+	WALLTYPE_TABLE(CONVERT_WALLTYPE_NAME)
+};
+
+#undef CONVERT_WALLTYPE_NAME
+
+static const char *convert_spawn_names[LEVEL_SPAWN_NUMTYPES] = {
+	"player"
+};
+
+typedef struct {
+	Memory memory;
+	World *world;
+
+	Tile palette[256];
+	bool defined[256];
+
+	LevelSpawn spawns[CONVERT_MAX_SPAWNS];
+	int num_spawns;
+
+	const char *filename;
+	int line;
+} Converter;
+
+static bool Convert_Line(Converter *converter, char *line);
+static bool Convert_Size(Converter *converter, const char *args);
+static bool Convert_Tile(Converter *converter, const char *args);
+static bool Convert_Fill(Converter *converter, const char *args);
+static bool Convert_Row(Converter *converter, const char *args);
+static bool Convert_Light(Converter *converter, const char *args);
+static bool Convert_Spawn(Converter *converter, const char *args);
+static bool Convert_EditTile(Converter *converter, int x, int z, unsigned char name);
+static bool Convert_Error(const Converter *converter, const char *message);
+
+int main(int argc, char **argv) {
+	static Converter converter;
+	char line[CONVERT_MAX_LINE];
+	bool ok = true;
+	FILE *file;
+
+	if(argc != 3) {
+		fprintf(stderr, "usage: %s input.txt output.level\n", argv[0]);
+		return 1;
+	}
+
+	file = fopen(argv[1], "r");
+
+	if(file == NULL) {
+		fprintf(stderr, "Failed to open %s.\n", argv[1]);
+		return 1;
+	}
+
+	if(!Memory_Reserve(&converter.memory, CONVERT_MEMORY, MEMORY_HUGE_PAGES_TRANSPARENT)) {
+		fclose(file);
+		return 1;
+	}
+
+	converter.filename = argv[1];
+
+	while(ok && fgets(line, sizeof(line), file) != NULL) {
+		converter.line++;
+		ok = Convert_Line(&converter, line);
+	}
+
+	fclose(file);
+
+	if(ok && converter.world == NULL)
+		ok = Convert_Error(&converter, "missing size");
+
+	if(ok)
+		ok = Level_Save(converter.world, converter.spawns, converter.num_spawns, argv[2]);
+
+	if(ok)
+		printf("%s: %d chunks, %d lights, %d spawns\n", argv[2], converter.world->num_chunks, converter.world->num_lights, converter.num_spawns);
+
+	Memory_Release(&converter.memory);
+
+	return ok ? 0 : 1;
+}
+
+static bool Convert_Line(Converter *converter, char *line) {
+	char command[16];
+	int length;
+
+	line[strcspn(line, "#\r\n")] = '\0';
+
+	if(sscanf(line, "%15s%n", command, &length) != 1)
+		return true;
+
+	if(strcmp(command, "size") == 0)
+		return Convert_Size(converter, line + length);
+
+	if(converter->world == NULL)
+		return Convert_Error(converter, "size must come first");
+
+	if(strcmp(command, "tile") == 0)
+		return Convert_Tile(converter, line + length);
+
+	if(strcmp(command, "fill") == 0)
+		return Convert_Fill(converter, line + length);
+
+	if(strcmp(command, "row") == 0)
+		return Convert_Row(converter, line + length);
+
+	if(strcmp(command, "light") == 0)
+		return Convert_Light(converter, line + length);
+
+	if(strcmp(command, "spawn") == 0)
+		return Convert_Spawn(converter, line + length);
+
+	return Convert_Error(converter, "unknown command");
+}
+
+static bool Convert_Size(Converter *converter, const char *args) {
+	int width, height, chunks_x, chunks_y;
+
+	if(converter->world != NULL)
+		return Convert_Error(converter, "size given twice");
+
+	if(sscanf(args, "%d %d", &width, &height) != 2 || width <= 0 || height <= 0)
+		return Convert_Error(converter, "expected size <width> <height>");
+
+	/* O mundo cabe inteiro, um slot para cada chunk da grade */
+	chunks_x = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	chunks_y = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	converter->world = Memory_AllocTagged(&converter->memory, sizeof(World), MEMORY_CACHE_LINE, MEMTAG_WORLD);
+
+	if(converter->world == NULL || !World_Create(converter->world, &converter->memory, width, height, chunks_x * chunks_y))
+		return Convert_Error(converter, "level too big");
+
+	return true;
+}
+
+static bool Convert_Tile(Converter *converter, const char *args) {
+	char name[2], wall_type[64];
+	Tile tile;
+	int k;
+
+	if(
+			sscanf(
+				args,
+				"%1s %f %f %d %d %d %d %d %63s",
+				name,
+				&tile.bot_height, &tile.top_height,
+				&tile.bot_texture, &tile.top_texture, &tile.wall_texture,
+				&tile.bot_window_texture, &tile.top_window_texture,
+				wall_type
+				) != 9
+	  )
+		return Convert_Error(converter, "expected tile <c> <floor> <ceiling> <floor texture> <ceiling texture> <wall texture> <bottom window> <top window> <wall type>");
+
+	for(k = 0; k < WALLTYPE_NUMTYPES; k++) {
+		if(strcmp(wall_type, convert_walltype_names[k]) == 0)
+			break;
+	}
+
+	if(k == WALLTYPE_NUMTYPES)
+		return Convert_Error(converter, "unknown wall type");
+
+	tile.wall_type = (WallType) k;
+
+	converter->palette[(unsigned char) name[0]] = tile;
+	converter->defined[(unsigned char) name[0]] = true;
+
+	return true;
+}
+
+static bool Convert_Fill(Converter *converter, const char *args) {
+	char name[2];
+	int x0, z0, x1, z1;
+
+	if(sscanf(args, "%1s %d %d %d %d", name, &x0, &z0, &x1, &z1) != 5)
+		return Convert_Error(converter, "expected fill <c> <x0> <z0> <x1> <z1>");
+
+	for(int z = z0; z < z1; z++) {
+		for(int x = x0; x < x1; x++) {
+			if(!Convert_EditTile(converter, x, z, (unsigned char) name[0]))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool Convert_Row(Converter *converter, const char *args) {
+	char tiles[CONVERT_MAX_LINE];
+	int x, z;
+
+	if(sscanf(args, "%d %d %4095s", &x, &z, tiles) != 3)
+		return Convert_Error(converter, "expected row <x> <z> <tiles>");
+
+	for(int i = 0; tiles[i] != '\0'; i++) {
+		if(!Convert_EditTile(converter, x + i, z, (unsigned char) tiles[i]))
+			return false;
+	}
+
+	return true;
+}
+
+static bool Convert_Light(Converter *converter, const char *args) {
+	Vec3 position, color;
+	float radius;
+
+	if(sscanf(args, "%f %f %f %f %f %f %f", &position.x, &position.y, &position.z, &color.x, &color.y, &color.z, &radius) != 7)
+		return Convert_Error(converter, "expected light <x> <y> <z> <r> <g> <b> <radius>");
+
+	if(!World_AddLight(converter->world, &position, &color, radius))
+		return Convert_Error(converter, "too many lights or bad radius");
+
+	return true;
+}
+
+static bool Convert_Spawn(Converter *converter, const char *args) {
+	LevelSpawn *spawn;
+	char type[64];
+	int k;
+
+	if(converter->num_spawns >= CONVERT_MAX_SPAWNS)
+		return Convert_Error(converter, "too many spawns");
+
+	spawn = &converter->spawns[converter->num_spawns];
+
+	if(sscanf(args, "%63s %f %f %f %f", type, &spawn->position.x, &spawn->position.y, &spawn->position.z, &spawn->angle) != 5)
+		return Convert_Error(converter, "expected spawn <type> <x> <y> <z> <angle>");
+
+	for(k = 0; k < LEVEL_SPAWN_NUMTYPES; k++) {
+		if(strcmp(type, convert_spawn_names[k]) == 0)
+			break;
+	}
+
+	if(k == LEVEL_SPAWN_NUMTYPES)
+		return Convert_Error(converter, "unknown spawn type");
+
+	spawn->type = (uint32_t) k;
+	converter->num_spawns++;
+
+	return true;
+}
+
+static bool Convert_EditTile(Converter *converter, int x, int z, unsigned char name) {
+	if(!converter->defined[name])
+		return Convert_Error(converter, "undefined tile");
+
+	/* Falha fora do mundo e com alturas ou texturas que não cabem em
+	 * PackedTile */
+	if(!World_EditTile(converter->world, x, z, &converter->palette[name]))
+		return Convert_Error(converter, "tile outside the level or out of range");
+
+	return true;
+}
+
+static bool Convert_Error(const Converter *converter, const char *message) {
+	fprintf(stderr, "%s:%d: %s\n", converter->filename, converter->line, message);
+
+	return false;
+}